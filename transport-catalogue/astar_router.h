@@ -0,0 +1,237 @@
+#pragma once
+
+#include "graph.h"
+#include "router.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <queue>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+namespace graph {
+
+// Goal-directed point-to-point search: Dijkstra ordered by weight + potential, where the
+// potential is a lower bound of the remaining weight to the target. With a consistent
+// potential the search settles only the vertices "in the direction" of the target;
+// a zero potential turns it into plain Dijkstra.
+template <typename Weight>
+class AStarRouter : public RouterInterface<Weight> {
+private:
+    using Graph = DirectedWeightedGraph<Weight>;
+
+public:
+    using typename RouterInterface<Weight>::RouteInfo;
+    // Lower bound of the route weight from vertex to target
+    using Potential = std::function<Weight(VertexId vertex, VertexId target)>;
+
+    AStarRouter(const Graph& graph, Potential potential);
+
+    std::optional<RouteInfo> BuildRoute(VertexId from, VertexId to) const override;
+    // There is no single target to direct the search to, so this is plain Dijkstra
+    // that stops as soon as all the targets are settled
+    std::vector<std::optional<Weight>> BuildWeights(VertexId from, const std::vector<VertexId>& targets) const override;
+
+private:
+    static constexpr EdgeId NO_EDGE = std::numeric_limits<EdgeId>::max();
+
+    // Per query state, reset in O(1) between queries by bumping the stamp
+    struct SearchSpace {
+        explicit SearchSpace(size_t vertex_count)
+            : weights(vertex_count)
+            , potentials(vertex_count)
+            , prev_edges(vertex_count, NO_EDGE)
+            , stamps(vertex_count, 0)
+            , target_stamps(vertex_count, 0) {
+        }
+
+        std::vector<Weight> weights;
+        std::vector<Weight> potentials;
+        std::vector<EdgeId> prev_edges;
+        std::vector<uint32_t> stamps;
+        // Targets of BuildWeights that are not settled yet
+        std::vector<uint32_t> target_stamps;
+        uint32_t stamp = 0;
+    };
+
+    struct QueueItem {
+        Weight priority;
+        Weight weight;
+        VertexId vertex;
+
+        bool operator>(const QueueItem& other) const {
+            return priority > other.priority;
+        }
+    };
+
+    static void NewSearch(SearchSpace& space);
+    std::unique_ptr<SearchSpace> AcquireSearchSpace() const;
+    void ReleaseSearchSpace(std::unique_ptr<SearchSpace> space) const;
+
+    static constexpr Weight ZERO_WEIGHT{};
+    const Graph& graph_;
+    Potential potential_;
+
+    mutable std::mutex search_spaces_mutex_;
+    mutable std::vector<std::unique_ptr<SearchSpace>> search_spaces_;
+};
+
+template <typename Weight>
+AStarRouter<Weight>::AStarRouter(const Graph& graph, Potential potential)
+    : graph_(graph)
+    , potential_(std::move(potential))
+{
+    for (EdgeId edge_id = 0; edge_id < graph.GetEdgeCount(); ++edge_id) {
+        if (graph.GetEdge(edge_id).weight < ZERO_WEIGHT) {
+            throw std::domain_error("Edges' weights should be non-negative");
+        }
+    }
+}
+
+template <typename Weight>
+std::optional<typename AStarRouter<Weight>::RouteInfo> AStarRouter<Weight>::BuildRoute(VertexId from,
+                                                                                       VertexId to) const {
+    if (from >= graph_.GetVertexCount() || to >= graph_.GetVertexCount()) {
+        throw std::out_of_range("Vertex id is out of range");
+    }
+
+    auto space = AcquireSearchSpace();
+    NewSearch(*space);
+    auto reach = [&space, this, to](VertexId vertex, Weight weight, EdgeId prev_edge) {
+        if (space->stamps[vertex] != space->stamp) {
+            space->stamps[vertex] = space->stamp;
+            space->potentials[vertex] = potential_(vertex, to);
+        }
+        space->weights[vertex] = weight;
+        space->prev_edges[vertex] = prev_edge;
+        return weight + space->potentials[vertex];
+    };
+
+    std::priority_queue<QueueItem, std::vector<QueueItem>, std::greater<QueueItem>> queue;
+    queue.push({reach(from, ZERO_WEIGHT, NO_EDGE), ZERO_WEIGHT, from});
+    bool is_found = false;
+    while (!queue.empty()) {
+        const QueueItem item = queue.top();
+        queue.pop();
+        // Outdated item; a vertex may be improved after it was popped if rounding
+        // makes the potential slightly inconsistent, so no settled flags are kept
+        if (space->weights[item.vertex] < item.weight) {
+            continue;
+        }
+        if (item.vertex == to) {
+            is_found = true;
+            break;
+        }
+        graph_.ForEachIncidentEdge(item.vertex, [&](EdgeId edge_id, VertexId next, Weight edge_weight) {
+            const Weight candidate_weight = item.weight + edge_weight;
+            if (space->stamps[next] != space->stamp || candidate_weight < space->weights[next]) {
+                queue.push({reach(next, candidate_weight, edge_id), candidate_weight, next});
+            }
+        });
+    }
+
+    std::optional<RouteInfo> result;
+    if (is_found) {
+        std::vector<EdgeId> edges;
+        for (EdgeId edge_id = space->prev_edges[to]; edge_id != NO_EDGE;
+             edge_id = space->prev_edges[graph_.GetEdge(edge_id).from])
+        {
+            edges.push_back(edge_id);
+        }
+        std::reverse(edges.begin(), edges.end());
+        result = RouteInfo{space->weights[to], std::move(edges)};
+    }
+    ReleaseSearchSpace(std::move(space));
+    return result;
+}
+
+template <typename Weight>
+std::vector<std::optional<Weight>> AStarRouter<Weight>::BuildWeights(VertexId from,
+                                                                    const std::vector<VertexId>& targets) const {
+    const size_t vertex_count = graph_.GetVertexCount();
+    if (from >= vertex_count) {
+        throw std::out_of_range("Vertex id is out of range");
+    }
+    auto space = AcquireSearchSpace();
+    NewSearch(*space);
+    size_t unsettled_count = 0;
+    for (const VertexId to : targets) {
+        if (to >= vertex_count) {
+            ReleaseSearchSpace(std::move(space));
+            throw std::out_of_range("Vertex id is out of range");
+        }
+        if (space->target_stamps[to] != space->stamp) {
+            space->target_stamps[to] = space->stamp;
+            ++unsettled_count;
+        }
+    }
+
+    using DijkstraItem = std::pair<Weight, VertexId>;
+    std::priority_queue<DijkstraItem, std::vector<DijkstraItem>, std::greater<DijkstraItem>> queue;
+    space->stamps[from] = space->stamp;
+    space->weights[from] = ZERO_WEIGHT;
+    queue.push({ZERO_WEIGHT, from});
+    while (!queue.empty() && unsettled_count > 0) {
+        const auto [weight, vertex] = queue.top();
+        queue.pop();
+        if (space->weights[vertex] < weight) {
+            continue;
+        }
+        if (space->target_stamps[vertex] == space->stamp) {
+            space->target_stamps[vertex] = 0;
+            --unsettled_count;
+        }
+        graph_.ForEachIncidentEdge(vertex, [&, weight = weight](EdgeId, VertexId next, Weight edge_weight) {
+            const Weight candidate_weight = weight + edge_weight;
+            if (space->stamps[next] != space->stamp || candidate_weight < space->weights[next]) {
+                space->stamps[next] = space->stamp;
+                space->weights[next] = candidate_weight;
+                queue.push({candidate_weight, next});
+            }
+        });
+    }
+
+    std::vector<std::optional<Weight>> weights;
+    weights.reserve(targets.size());
+    for (const VertexId to : targets) {
+        weights.push_back(space->stamps[to] == space->stamp ? std::optional<Weight>(space->weights[to]) : std::nullopt);
+    }
+    ReleaseSearchSpace(std::move(space));
+    return weights;
+}
+
+template <typename Weight>
+void AStarRouter<Weight>::NewSearch(SearchSpace& space) {
+    if (++space.stamp == 0) {
+        std::fill(space.stamps.begin(), space.stamps.end(), 0);
+        std::fill(space.target_stamps.begin(), space.target_stamps.end(), 0);
+        space.stamp = 1;
+    }
+}
+
+template <typename Weight>
+std::unique_ptr<typename AStarRouter<Weight>::SearchSpace> AStarRouter<Weight>::AcquireSearchSpace() const {
+    {
+        std::lock_guard guard(search_spaces_mutex_);
+        if (!search_spaces_.empty()) {
+            auto space = std::move(search_spaces_.back());
+            search_spaces_.pop_back();
+            return space;
+        }
+    }
+    return std::make_unique<SearchSpace>(graph_.GetVertexCount());
+}
+
+template <typename Weight>
+void AStarRouter<Weight>::ReleaseSearchSpace(std::unique_ptr<SearchSpace> space) const {
+    std::lock_guard guard(search_spaces_mutex_);
+    search_spaces_.push_back(std::move(space));
+}
+
+}  // namespace graph
@@ -0,0 +1,264 @@
+#pragma once
+
+#include "graph.h"
+#include "parallel.h"
+#include "router.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <vector>
+
+namespace graph {
+
+// All-pairs routing over the weakly connected components of the graph. No route leaves
+// its component, so a routing table per component replaces the single V x V table: the
+// memory and the build time go down to the sum over the squared component sizes.
+template <typename Weight, typename StoredWeight = Weight>
+class ComponentRouter : public RouterInterface<Weight> {
+private:
+    using Graph = DirectedWeightedGraph<Weight>;
+    using ComponentTable = Router<Weight, StoredWeight>;
+
+public:
+    using typename RouterInterface<Weight>::RouteInfo;
+    using typename RouterInterface<Weight>::ReachableCallback;
+
+    explicit ComponentRouter(const Graph& graph, TableAlgorithm algorithm = TableAlgorithm::FLOYD_WARSHALL);
+
+    std::optional<RouteInfo> BuildRoute(VertexId from, VertexId to) const override;
+    bool BuildRouteInto(VertexId from, VertexId to, RouteInfo& route) const override;
+    std::vector<std::optional<Weight>> BuildWeights(VertexId from, const std::vector<VertexId>& targets) const override;
+    bool ForEachReachable(VertexId from, Weight max_weight, const ReachableCallback& func) const override;
+
+    // Takes into account the edges added to the graph after the build, see
+    // Router::AddNewEdges. Returns false and changes nothing if the new edges join
+    // components or the graph got new vertices: then the router is to be rebuilt.
+    bool AddNewEdges();
+
+    size_t GetComponentCount() const;
+    // Routing table of the component
+    const ComponentTable& GetComponentTable(size_t component) const;
+    // Bytes taken by the routing tables of all the components
+    size_t GetTableSize() const;
+
+    // Union-find over the edges: the component of every vertex, numbered in the order
+    // of their smallest vertices
+    static std::vector<uint32_t> FindComponents(const Graph& graph, size_t& component_count);
+
+private:
+    // Components of at least this many vertices are built one by one, each with a
+    // parallel table build; the smaller ones are built in parallel with each other
+    static constexpr size_t PARALLEL_TABLE_SIZE = 1024;
+
+    struct Component {
+        // Ids in the graph of the local vertices and edges of the component
+        std::vector<VertexId> vertices;
+        std::vector<EdgeId> edges;
+        std::unique_ptr<Graph> graph;
+        std::unique_ptr<ComponentTable> table;
+    };
+
+    const Graph& graph_;
+    size_t edge_count_ = 0;
+    // Component of a vertex and its id in the component graph
+    std::vector<uint32_t> components_of_;
+    std::vector<VertexId> local_ids_;
+    std::vector<Component> components_;
+};
+
+template <typename Weight, typename StoredWeight>
+std::vector<uint32_t> ComponentRouter<Weight, StoredWeight>::FindComponents(const Graph& graph, size_t& component_count) {
+    const size_t vertex_count = graph.GetVertexCount();
+    std::vector<VertexId> parents(vertex_count);
+    for (VertexId vertex = 0; vertex < vertex_count; ++vertex) {
+        parents[vertex] = vertex;
+    }
+    auto find_root = [&parents](VertexId vertex) {
+        while (parents[vertex] != vertex) {
+            parents[vertex] = parents[parents[vertex]];
+            vertex = parents[vertex];
+        }
+        return vertex;
+    };
+    for (EdgeId edge_id = 0; edge_id < graph.GetEdgeCount(); ++edge_id) {
+        const auto& edge = graph.GetEdge(edge_id);
+        const VertexId from_root = find_root(edge.from);
+        const VertexId to_root = find_root(edge.to);
+        // The smaller vertex stays the root, so roots are the smallest vertices of the components
+        if (from_root < to_root) {
+            parents[to_root] = from_root;
+        } else if (to_root < from_root) {
+            parents[from_root] = to_root;
+        }
+    }
+
+    std::vector<uint32_t> components(vertex_count);
+    component_count = 0;
+    for (VertexId vertex = 0; vertex < vertex_count; ++vertex) {
+        const VertexId root = find_root(vertex);
+        components[vertex] = root == vertex ? static_cast<uint32_t>(component_count++) : components[root];
+    }
+    return components;
+}
+
+template <typename Weight, typename StoredWeight>
+ComponentRouter<Weight, StoredWeight>::ComponentRouter(const Graph& graph, TableAlgorithm algorithm)
+    : graph_(graph)
+    , edge_count_(graph.GetEdgeCount())
+    , local_ids_(graph.GetVertexCount())
+{
+    size_t component_count = 0;
+    components_of_ = FindComponents(graph, component_count);
+    components_.resize(component_count);
+    for (VertexId vertex = 0; vertex < graph.GetVertexCount(); ++vertex) {
+        auto& vertices = components_[components_of_[vertex]].vertices;
+        local_ids_[vertex] = vertices.size();
+        vertices.push_back(vertex);
+    }
+    for (Component& component : components_) {
+        component.graph = std::make_unique<Graph>(component.vertices.size());
+    }
+    // Edges keep their relative order, so the tables break ties as a single table would
+    for (EdgeId edge_id = 0; edge_id < edge_count_; ++edge_id) {
+        const auto& edge = graph.GetEdge(edge_id);
+        Component& component = components_[components_of_[edge.from]];
+        component.graph->AddEdge({local_ids_[edge.from], local_ids_[edge.to], edge.weight});
+        component.edges.push_back(edge_id);
+    }
+
+    std::vector<size_t> small_components;
+    for (size_t index = 0; index < components_.size(); ++index) {
+        Component& component = components_[index];
+        component.graph->Freeze();
+        if (component.vertices.size() >= PARALLEL_TABLE_SIZE) {
+            component.table = std::make_unique<ComponentTable>(*component.graph, algorithm);
+        } else {
+            small_components.push_back(index);
+        }
+    }
+    parallel::ForEachIndex(small_components.size(), [this, &small_components, algorithm](size_t index) {
+        Component& component = components_[small_components[index]];
+        component.table = std::make_unique<ComponentTable>(*component.graph, algorithm);
+    });
+}
+
+template <typename Weight, typename StoredWeight>
+std::optional<typename ComponentRouter<Weight, StoredWeight>::RouteInfo>
+ComponentRouter<Weight, StoredWeight>::BuildRoute(VertexId from, VertexId to) const {
+    RouteInfo route;
+    if (!BuildRouteInto(from, to, route)) {
+        return std::nullopt;
+    }
+    return route;
+}
+
+template <typename Weight, typename StoredWeight>
+bool ComponentRouter<Weight, StoredWeight>::BuildRouteInto(VertexId from, VertexId to, RouteInfo& route) const {
+    if (from >= components_of_.size() || to >= components_of_.size()) {
+        throw std::out_of_range("Vertex id is out of range");
+    }
+    if (components_of_[from] != components_of_[to]) {
+        return false;
+    }
+    const Component& component = components_[components_of_[from]];
+    if (!component.table->BuildRouteInto(local_ids_[from], local_ids_[to], route)) {
+        return false;
+    }
+    for (EdgeId& edge_id : route.edges) {
+        edge_id = component.edges[edge_id];
+    }
+    return true;
+}
+
+template <typename Weight, typename StoredWeight>
+std::vector<std::optional<Weight>> ComponentRouter<Weight, StoredWeight>::BuildWeights(VertexId from,
+                                                                                      const std::vector<VertexId>& targets) const {
+    if (from >= components_of_.size()) {
+        throw std::out_of_range("Vertex id is out of range");
+    }
+    // Targets of the component of the source go to its table in one call
+    std::vector<VertexId> local_targets;
+    std::vector<size_t> positions;
+    for (size_t i = 0; i < targets.size(); ++i) {
+        if (targets[i] >= components_of_.size()) {
+            throw std::out_of_range("Vertex id is out of range");
+        }
+        if (components_of_[targets[i]] == components_of_[from]) {
+            local_targets.push_back(local_ids_[targets[i]]);
+            positions.push_back(i);
+        }
+    }
+    std::vector<std::optional<Weight>> weights(targets.size());
+    const auto local_weights = components_[components_of_[from]].table->BuildWeights(local_ids_[from], local_targets);
+    for (size_t i = 0; i < positions.size(); ++i) {
+        weights[positions[i]] = local_weights[i];
+    }
+    return weights;
+}
+
+template <typename Weight, typename StoredWeight>
+bool ComponentRouter<Weight, StoredWeight>::ForEachReachable(VertexId from, Weight max_weight, const ReachableCallback& func) const {
+    if (from >= components_of_.size()) {
+        throw std::out_of_range("Vertex id is out of range");
+    }
+    const Component& component = components_[components_of_[from]];
+    return component.table->ForEachReachable(local_ids_[from], max_weight, [&component, &func](VertexId vertex, Weight weight) {
+        func(component.vertices[vertex], weight);
+    });
+}
+
+template <typename Weight, typename StoredWeight>
+bool ComponentRouter<Weight, StoredWeight>::AddNewEdges() {
+    const size_t edge_count = graph_.GetEdgeCount();
+    if (graph_.GetVertexCount() != components_of_.size()) {
+        return false;
+    }
+    for (EdgeId edge_id = edge_count_; edge_id < edge_count; ++edge_id) {
+        const auto& edge = graph_.GetEdge(edge_id);
+        if (components_of_[edge.from] != components_of_[edge.to]) {
+            return false;
+        }
+    }
+
+    std::vector<uint32_t> changed_components;
+    for (EdgeId edge_id = edge_count_; edge_id < edge_count; ++edge_id) {
+        const auto& edge = graph_.GetEdge(edge_id);
+        Component& component = components_[components_of_[edge.from]];
+        component.graph->AddEdge({local_ids_[edge.from], local_ids_[edge.to], edge.weight});
+        component.edges.push_back(edge_id);
+        changed_components.push_back(components_of_[edge.from]);
+    }
+    std::sort(changed_components.begin(), changed_components.end());
+    changed_components.erase(std::unique(changed_components.begin(), changed_components.end()), changed_components.end());
+    for (const uint32_t index : changed_components) {
+        components_[index].graph->Freeze();
+        components_[index].table->AddNewEdges();
+    }
+    edge_count_ = edge_count;
+    return true;
+}
+
+template <typename Weight, typename StoredWeight>
+size_t ComponentRouter<Weight, StoredWeight>::GetComponentCount() const {
+    return components_.size();
+}
+
+template <typename Weight, typename StoredWeight>
+const typename ComponentRouter<Weight, StoredWeight>::ComponentTable&
+ComponentRouter<Weight, StoredWeight>::GetComponentTable(size_t component) const {
+    return *components_.at(component).table;
+}
+
+template <typename Weight, typename StoredWeight>
+size_t ComponentRouter<Weight, StoredWeight>::GetTableSize() const {
+    size_t size = 0;
+    for (const Component& component : components_) {
+        size += component.table->GetTableSize();
+    }
+    return size;
+}
+
+}  // namespace graph
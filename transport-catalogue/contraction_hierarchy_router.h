@@ -0,0 +1,562 @@
+#pragma once
+
+#include "graph.h"
+#include "router.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <queue>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+namespace graph {
+
+// Contraction Hierarchies: vertices are contracted one by one in the order of their
+// importance, shortcuts keep the distances between the remaining vertices. A query is
+// a bidirectional Dijkstra that only goes up the hierarchy; shortcuts of the found
+// path are unpacked back into the edges of the original graph.
+template <typename Weight>
+class ContractionHierarchyRouter : public RouterInterface<Weight> {
+private:
+    using Graph = DirectedWeightedGraph<Weight>;
+
+public:
+    using typename RouterInterface<Weight>::RouteInfo;
+
+    explicit ContractionHierarchyRouter(const Graph& graph);
+
+    std::optional<RouteInfo> BuildRoute(VertexId from, VertexId to) const override;
+    // One full upward search from the source, then a backward upward search per target
+    // that meets it; nothing is unpacked
+    std::vector<std::optional<Weight>> BuildWeights(VertexId from, const std::vector<VertexId>& targets) const override;
+
+    size_t GetShortcutCount() const;
+
+private:
+    static constexpr size_t NONE = std::numeric_limits<size_t>::max();
+    // Witness search gives up after settling this many vertices and adds the shortcut.
+    // Estimating priorities only looks at the direct arcs: transfer vertices of the
+    // transport graph have hundreds of arcs, so even short searches are expensive there
+    static constexpr size_t WITNESS_SETTLE_LIMIT = 500;
+    static constexpr size_t ESTIMATE_HOP_LIMIT = 1;
+    static constexpr size_t NO_HOP_LIMIT = NONE;
+
+    // An edge of the hierarchy: either an original edge or a shortcut over
+    // two other hierarchy edges
+    struct HierarchyEdge {
+        VertexId from;
+        VertexId to;
+        Weight weight;
+        EdgeId original_id;
+        size_t first_child = NONE;
+        size_t second_child = NONE;
+    };
+
+    struct Arc {
+        VertexId vertex;
+        Weight weight;
+        size_t edge;
+    };
+    using ArcList = std::vector<Arc>;
+
+    // Distances of a search, reset in O(1) between searches by bumping the stamp
+    struct SearchSpace {
+        explicit SearchSpace(size_t vertex_count)
+            : weights(vertex_count)
+            , parent_edges(vertex_count, NONE)
+            , stamps(vertex_count, 0) {
+        }
+        bool IsReached(VertexId vertex) const {
+            return stamps[vertex] == stamp;
+        }
+        void Reach(VertexId vertex, Weight weight, size_t parent_edge) {
+            stamps[vertex] = stamp;
+            weights[vertex] = weight;
+            parent_edges[vertex] = parent_edge;
+        }
+
+        std::vector<Weight> weights;
+        std::vector<size_t> parent_edges;
+        std::vector<uint32_t> stamps;
+        uint32_t stamp = 0;
+    };
+
+    struct WitnessSpace : SearchSpace {
+        explicit WitnessSpace(size_t vertex_count)
+            : SearchSpace(vertex_count)
+            , target_stamps(vertex_count, 0)
+            , hops(vertex_count, 0) {
+        }
+        std::vector<uint32_t> target_stamps;
+        std::vector<size_t> hops;
+    };
+
+    struct QuerySpace {
+        explicit QuerySpace(size_t vertex_count)
+            : forward(vertex_count)
+            , backward(vertex_count) {
+        }
+        SearchSpace forward;
+        SearchSpace backward;
+    };
+
+    using QueueItem = std::pair<Weight, VertexId>;
+    using Queue = std::priority_queue<QueueItem, std::vector<QueueItem>, std::greater<QueueItem>>;
+
+    void Contract(std::vector<ArcList>& out_arcs, std::vector<ArcList>& in_arcs);
+    // Returns the number of shortcuts that contraction of the vertex requires;
+    // adds them if add_shortcuts is set
+    size_t ContractVertex(VertexId vertex, std::vector<ArcList>& out_arcs, std::vector<ArcList>& in_arcs,
+                          WitnessSpace& witness, bool add_shortcuts);
+    // Stops as soon as all the targets marked in the witness space are settled
+    void RunWitnessSearch(VertexId source, VertexId excluded, Weight max_weight, size_t target_count,
+                          size_t hop_limit, const std::vector<ArcList>& out_arcs, WitnessSpace& witness) const;
+    void AddShortcut(VertexId from, VertexId to, Weight weight, size_t first_child, size_t second_child,
+                     std::vector<ArcList>& out_arcs, std::vector<ArcList>& in_arcs);
+
+    static void NewSearch(SearchSpace& space);
+    void SearchStep(Queue& queue, SearchSpace& space, const SearchSpace& opposite,
+                    const std::vector<ArcList>& up_arcs, std::optional<Weight>& best, VertexId& meeting) const;
+    // Runs an upward search to exhaustion, collecting the reached vertices
+    void RunUpwardSearch(VertexId source, SearchSpace& space, const std::vector<ArcList>& up_arcs,
+                         std::vector<VertexId>& reached) const;
+    void UnpackEdge(size_t edge, std::vector<EdgeId>& edges) const;
+
+    std::unique_ptr<QuerySpace> AcquireQuerySpace() const;
+    void ReleaseQuerySpace(std::unique_ptr<QuerySpace> space) const;
+
+    static constexpr Weight ZERO_WEIGHT{};
+    size_t vertex_count_ = 0;
+    size_t original_edge_count_ = 0;
+    std::vector<HierarchyEdge> edges_;
+    std::vector<size_t> ranks_;
+    // Upward search graphs: forward arcs lead from a vertex to higher ranked vertices,
+    // backward arcs lead to higher ranked vertices along reversed edges
+    std::vector<ArcList> forward_up_;
+    std::vector<ArcList> backward_up_;
+
+    mutable std::mutex query_spaces_mutex_;
+    mutable std::vector<std::unique_ptr<QuerySpace>> query_spaces_;
+};
+
+template <typename Weight>
+ContractionHierarchyRouter<Weight>::ContractionHierarchyRouter(const Graph& graph)
+    : vertex_count_(graph.GetVertexCount())
+    , original_edge_count_(graph.GetEdgeCount())
+    , ranks_(graph.GetVertexCount(), 0)
+    , forward_up_(graph.GetVertexCount())
+    , backward_up_(graph.GetVertexCount())
+{
+    std::vector<ArcList> out_arcs(vertex_count_);
+    std::vector<ArcList> in_arcs(vertex_count_);
+    for (VertexId vertex = 0; vertex < vertex_count_; ++vertex) {
+        for (const EdgeId edge_id : graph.GetIncidentEdges(vertex)) {
+            const auto& edge = graph.GetEdge(edge_id);
+            if (edge.weight < ZERO_WEIGHT) {
+                throw std::domain_error("Edges' weights should be non-negative");
+            }
+            if (edge.from == edge.to) {
+                continue;
+            }
+            // Only the lightest of the parallel edges takes part in the hierarchy
+            auto it = std::find_if(out_arcs[edge.from].begin(), out_arcs[edge.from].end(), [&edge](const Arc& arc) {
+                return arc.vertex == edge.to;
+            });
+            if (it != out_arcs[edge.from].end()) {
+                if (edge.weight < it->weight) {
+                    edges_[it->edge] = HierarchyEdge{edge.from, edge.to, edge.weight, edge_id};
+                    it->weight = edge.weight;
+                    for (Arc& arc : in_arcs[edge.to]) {
+                        if (arc.edge == it->edge) {
+                            arc.weight = edge.weight;
+                        }
+                    }
+                }
+                continue;
+            }
+            edges_.push_back(HierarchyEdge{edge.from, edge.to, edge.weight, edge_id});
+            out_arcs[edge.from].push_back({edge.to, edge.weight, edges_.size() - 1});
+            in_arcs[edge.to].push_back({edge.from, edge.weight, edges_.size() - 1});
+        }
+    }
+    Contract(out_arcs, in_arcs);
+}
+
+template <typename Weight>
+size_t ContractionHierarchyRouter<Weight>::GetShortcutCount() const {
+    return std::count_if(edges_.begin(), edges_.end(), [](const HierarchyEdge& edge) {
+        return edge.first_child != NONE;
+    });
+}
+
+template <typename Weight>
+void ContractionHierarchyRouter<Weight>::Contract(std::vector<ArcList>& out_arcs, std::vector<ArcList>& in_arcs) {
+    WitnessSpace witness(vertex_count_);
+    std::vector<size_t> contracted_neighbours(vertex_count_, 0);
+    std::vector<bool> contracted(vertex_count_, false);
+
+    // Priority is the edge difference plus the number of already contracted neighbours,
+    // which spreads contraction evenly over the graph
+    auto priority = [&](VertexId vertex) {
+        const size_t shortcuts = ContractVertex(vertex, out_arcs, in_arcs, witness, false);
+        return static_cast<int64_t>(shortcuts) - static_cast<int64_t>(out_arcs[vertex].size() + in_arcs[vertex].size())
+            + static_cast<int64_t>(contracted_neighbours[vertex]);
+    };
+
+    using PriorityItem = std::pair<int64_t, VertexId>;
+    std::priority_queue<PriorityItem, std::vector<PriorityItem>, std::greater<PriorityItem>> queue;
+    for (VertexId vertex = 0; vertex < vertex_count_; ++vertex) {
+        queue.push({priority(vertex), vertex});
+    }
+
+    size_t rank = 0;
+    while (!queue.empty()) {
+        const VertexId vertex = queue.top().second;
+        queue.pop();
+        if (contracted[vertex]) {
+            continue;
+        }
+        // Lazy update: the priority may have grown since the vertex was queued
+        const int64_t current_priority = priority(vertex);
+        if (!queue.empty() && current_priority > queue.top().first) {
+            queue.push({current_priority, vertex});
+            continue;
+        }
+
+        ContractVertex(vertex, out_arcs, in_arcs, witness, true);
+        contracted[vertex] = true;
+        ranks_[vertex] = rank++;
+
+        for (const Arc& arc : out_arcs[vertex]) {
+            auto& neighbour_in = in_arcs[arc.vertex];
+            neighbour_in.erase(std::remove_if(neighbour_in.begin(), neighbour_in.end(), [vertex](const Arc& in_arc) {
+                return in_arc.vertex == vertex;
+            }), neighbour_in.end());
+            ++contracted_neighbours[arc.vertex];
+        }
+        for (const Arc& arc : in_arcs[vertex]) {
+            auto& neighbour_out = out_arcs[arc.vertex];
+            neighbour_out.erase(std::remove_if(neighbour_out.begin(), neighbour_out.end(), [vertex](const Arc& out_arc) {
+                return out_arc.vertex == vertex;
+            }), neighbour_out.end());
+            ++contracted_neighbours[arc.vertex];
+        }
+        // All the remaining neighbours are ranked higher than the vertex
+        forward_up_[vertex] = std::move(out_arcs[vertex]);
+        backward_up_[vertex] = std::move(in_arcs[vertex]);
+        out_arcs[vertex].clear();
+        in_arcs[vertex].clear();
+    }
+}
+
+template <typename Weight>
+size_t ContractionHierarchyRouter<Weight>::ContractVertex(VertexId vertex, std::vector<ArcList>& out_arcs,
+                                                          std::vector<ArcList>& in_arcs, WitnessSpace& witness,
+                                                          bool add_shortcuts) {
+    if (out_arcs[vertex].empty() || in_arcs[vertex].empty()) {
+        return 0;
+    }
+    Weight max_out_weight = ZERO_WEIGHT;
+    for (const Arc& out_arc : out_arcs[vertex]) {
+        max_out_weight = std::max(max_out_weight, out_arc.weight);
+    }
+
+    size_t shortcut_count = 0;
+    // Shortcuts are collected first: adding them changes the lists being iterated
+    std::vector<HierarchyEdge> shortcuts;
+    for (const Arc& in_arc : in_arcs[vertex]) {
+        NewSearch(witness);
+        size_t target_count = 0;
+        for (const Arc& out_arc : out_arcs[vertex]) {
+            // A vertex entered only from the contracted one cannot have a witness
+            if (out_arc.vertex != in_arc.vertex && in_arcs[out_arc.vertex].size() > 1
+                && witness.target_stamps[out_arc.vertex] != witness.stamp) {
+                witness.target_stamps[out_arc.vertex] = witness.stamp;
+                ++target_count;
+            }
+        }
+        RunWitnessSearch(in_arc.vertex, vertex, in_arc.weight + max_out_weight, target_count,
+                         add_shortcuts ? NO_HOP_LIMIT : ESTIMATE_HOP_LIMIT, out_arcs, witness);
+        for (const Arc& out_arc : out_arcs[vertex]) {
+            if (out_arc.vertex == in_arc.vertex) {
+                continue;
+            }
+            const Weight via_weight = in_arc.weight + out_arc.weight;
+            if (witness.IsReached(out_arc.vertex) && !(via_weight < witness.weights[out_arc.vertex])) {
+                continue;
+            }
+            ++shortcut_count;
+            if (add_shortcuts) {
+                shortcuts.push_back(HierarchyEdge{in_arc.vertex, out_arc.vertex, via_weight, 0, in_arc.edge, out_arc.edge});
+            }
+        }
+    }
+    for (const HierarchyEdge& shortcut : shortcuts) {
+        AddShortcut(shortcut.from, shortcut.to, shortcut.weight, shortcut.first_child, shortcut.second_child,
+                    out_arcs, in_arcs);
+    }
+    return shortcut_count;
+}
+
+template <typename Weight>
+void ContractionHierarchyRouter<Weight>::RunWitnessSearch(VertexId source, VertexId excluded, Weight max_weight,
+                                                          size_t target_count, size_t hop_limit,
+                                                          const std::vector<ArcList>& out_arcs,
+                                                          WitnessSpace& witness) const {
+    Queue queue;
+    witness.Reach(source, ZERO_WEIGHT, NONE);
+    witness.hops[source] = 0;
+    queue.push({ZERO_WEIGHT, source});
+    size_t settled = 0;
+    while (!queue.empty() && settled < WITNESS_SETTLE_LIMIT && target_count > 0) {
+        const auto [weight, vertex] = queue.top();
+        queue.pop();
+        if (witness.weights[vertex] < weight) {
+            continue;
+        }
+        if (max_weight < weight) {
+            break;
+        }
+        ++settled;
+        if (witness.target_stamps[vertex] == witness.stamp) {
+            --target_count;
+        }
+        if (witness.hops[vertex] >= hop_limit) {
+            continue;
+        }
+        for (const Arc& arc : out_arcs[vertex]) {
+            if (arc.vertex == excluded) {
+                continue;
+            }
+            const Weight candidate_weight = weight + arc.weight;
+            if (!witness.IsReached(arc.vertex) || candidate_weight < witness.weights[arc.vertex]) {
+                witness.Reach(arc.vertex, candidate_weight, NONE);
+                witness.hops[arc.vertex] = witness.hops[vertex] + 1;
+                queue.push({candidate_weight, arc.vertex});
+            }
+        }
+    }
+}
+
+template <typename Weight>
+void ContractionHierarchyRouter<Weight>::AddShortcut(VertexId from, VertexId to, Weight weight, size_t first_child,
+                                                     size_t second_child, std::vector<ArcList>& out_arcs,
+                                                     std::vector<ArcList>& in_arcs) {
+    auto it = std::find_if(out_arcs[from].begin(), out_arcs[from].end(), [to](const Arc& arc) {
+        return arc.vertex == to;
+    });
+    if (it != out_arcs[from].end() && !(weight < it->weight)) {
+        return;
+    }
+    edges_.push_back(HierarchyEdge{from, to, weight, 0, first_child, second_child});
+    const size_t edge = edges_.size() - 1;
+    if (it != out_arcs[from].end()) {
+        *it = Arc{to, weight, edge};
+        for (Arc& arc : in_arcs[to]) {
+            if (arc.vertex == from) {
+                arc = Arc{from, weight, edge};
+            }
+        }
+        return;
+    }
+    out_arcs[from].push_back({to, weight, edge});
+    in_arcs[to].push_back({from, weight, edge});
+}
+
+template <typename Weight>
+void ContractionHierarchyRouter<Weight>::NewSearch(SearchSpace& space) {
+    if (++space.stamp == 0) {
+        std::fill(space.stamps.begin(), space.stamps.end(), 0);
+        space.stamp = 1;
+    }
+}
+
+template <typename Weight>
+std::optional<typename ContractionHierarchyRouter<Weight>::RouteInfo>
+ContractionHierarchyRouter<Weight>::BuildRoute(VertexId from, VertexId to) const {
+    if (from >= vertex_count_ || to >= vertex_count_) {
+        throw std::out_of_range("Vertex id is out of range");
+    }
+    if (from == to) {
+        return RouteInfo{ZERO_WEIGHT, {}};
+    }
+
+    auto space = AcquireQuerySpace();
+    NewSearch(space->forward);
+    NewSearch(space->backward);
+    Queue forward_queue;
+    Queue backward_queue;
+    space->forward.Reach(from, ZERO_WEIGHT, NONE);
+    space->backward.Reach(to, ZERO_WEIGHT, NONE);
+    forward_queue.push({ZERO_WEIGHT, from});
+    backward_queue.push({ZERO_WEIGHT, to});
+
+    std::optional<Weight> best;
+    VertexId meeting = 0;
+    while (!forward_queue.empty() || !backward_queue.empty()) {
+        const bool forward_done = forward_queue.empty() || (best && !(forward_queue.top().first < *best));
+        const bool backward_done = backward_queue.empty() || (best && !(backward_queue.top().first < *best));
+        if (forward_done && backward_done) {
+            break;
+        }
+        if (!forward_done && (backward_done || !(backward_queue.top().first < forward_queue.top().first))) {
+            SearchStep(forward_queue, space->forward, space->backward, forward_up_, best, meeting);
+        } else {
+            SearchStep(backward_queue, space->backward, space->forward, backward_up_, best, meeting);
+        }
+    }
+
+    std::optional<RouteInfo> result;
+    if (best) {
+        std::vector<size_t> forward_path;
+        for (VertexId vertex = meeting; space->forward.parent_edges[vertex] != NONE;
+             vertex = edges_[space->forward.parent_edges[vertex]].from)
+        {
+            forward_path.push_back(space->forward.parent_edges[vertex]);
+        }
+        std::vector<EdgeId> edges;
+        for (auto it = forward_path.rbegin(); it != forward_path.rend(); ++it) {
+            UnpackEdge(*it, edges);
+        }
+        for (VertexId vertex = meeting; space->backward.parent_edges[vertex] != NONE;
+             vertex = edges_[space->backward.parent_edges[vertex]].to)
+        {
+            UnpackEdge(space->backward.parent_edges[vertex], edges);
+        }
+        result = RouteInfo{*best, std::move(edges)};
+    }
+    ReleaseQuerySpace(std::move(space));
+    return result;
+}
+
+template <typename Weight>
+std::vector<std::optional<Weight>> ContractionHierarchyRouter<Weight>::BuildWeights(
+    VertexId from, const std::vector<VertexId>& targets) const {
+    if (from >= vertex_count_) {
+        throw std::out_of_range("Vertex id is out of range");
+    }
+    for (const VertexId to : targets) {
+        if (to >= vertex_count_) {
+            throw std::out_of_range("Vertex id is out of range");
+        }
+    }
+
+    auto space = AcquireQuerySpace();
+    std::vector<VertexId> forward_reached;
+    std::vector<VertexId> backward_reached;
+    RunUpwardSearch(from, space->forward, forward_up_, forward_reached);
+    std::vector<std::optional<Weight>> weights;
+    weights.reserve(targets.size());
+    for (const VertexId to : targets) {
+        RunUpwardSearch(to, space->backward, backward_up_, backward_reached);
+        std::optional<Weight> best;
+        for (const VertexId vertex : backward_reached) {
+            if (space->forward.IsReached(vertex)) {
+                const Weight total_weight = space->forward.weights[vertex] + space->backward.weights[vertex];
+                if (!best || total_weight < *best) {
+                    best = total_weight;
+                }
+            }
+        }
+        weights.push_back(best);
+    }
+    ReleaseQuerySpace(std::move(space));
+    return weights;
+}
+
+template <typename Weight>
+void ContractionHierarchyRouter<Weight>::RunUpwardSearch(VertexId source, SearchSpace& space,
+                                                         const std::vector<ArcList>& up_arcs,
+                                                         std::vector<VertexId>& reached) const {
+    NewSearch(space);
+    reached.clear();
+    Queue queue;
+    space.Reach(source, ZERO_WEIGHT, NONE);
+    reached.push_back(source);
+    queue.push({ZERO_WEIGHT, source});
+    while (!queue.empty()) {
+        const auto [weight, vertex] = queue.top();
+        queue.pop();
+        if (space.weights[vertex] < weight) {
+            continue;
+        }
+        for (const Arc& arc : up_arcs[vertex]) {
+            const Weight candidate_weight = weight + arc.weight;
+            if (!space.IsReached(arc.vertex)) {
+                reached.push_back(arc.vertex);
+            } else if (!(candidate_weight < space.weights[arc.vertex])) {
+                continue;
+            }
+            space.Reach(arc.vertex, candidate_weight, arc.edge);
+            queue.push({candidate_weight, arc.vertex});
+        }
+    }
+}
+
+template <typename Weight>
+void ContractionHierarchyRouter<Weight>::SearchStep(Queue& queue, SearchSpace& space, const SearchSpace& opposite,
+                                                    const std::vector<ArcList>& up_arcs, std::optional<Weight>& best,
+                                                    VertexId& meeting) const {
+    const auto [weight, vertex] = queue.top();
+    queue.pop();
+    if (space.weights[vertex] < weight) {
+        return;
+    }
+    if (opposite.IsReached(vertex)) {
+        const Weight total_weight = weight + opposite.weights[vertex];
+        if (!best || total_weight < *best) {
+            best = total_weight;
+            meeting = vertex;
+        }
+    }
+    for (const Arc& arc : up_arcs[vertex]) {
+        const Weight candidate_weight = weight + arc.weight;
+        if (!space.IsReached(arc.vertex) || candidate_weight < space.weights[arc.vertex]) {
+            space.Reach(arc.vertex, candidate_weight, arc.edge);
+            queue.push({candidate_weight, arc.vertex});
+        }
+    }
+}
+
+template <typename Weight>
+void ContractionHierarchyRouter<Weight>::UnpackEdge(size_t edge, std::vector<EdgeId>& edges) const {
+    std::vector<size_t> stack{edge};
+    while (!stack.empty()) {
+        const HierarchyEdge& current = edges_[stack.back()];
+        stack.pop_back();
+        if (current.first_child == NONE) {
+            edges.push_back(current.original_id);
+        } else {
+            stack.push_back(current.second_child);
+            stack.push_back(current.first_child);
+        }
+    }
+}
+
+template <typename Weight>
+std::unique_ptr<typename ContractionHierarchyRouter<Weight>::QuerySpace>
+ContractionHierarchyRouter<Weight>::AcquireQuerySpace() const {
+    {
+        std::lock_guard guard(query_spaces_mutex_);
+        if (!query_spaces_.empty()) {
+            auto space = std::move(query_spaces_.back());
+            query_spaces_.pop_back();
+            return space;
+        }
+    }
+    return std::make_unique<QuerySpace>(vertex_count_);
+}
+
+template <typename Weight>
+void ContractionHierarchyRouter<Weight>::ReleaseQuerySpace(std::unique_ptr<QuerySpace> space) const {
+    std::lock_guard guard(query_spaces_mutex_);
+    query_spaces_.push_back(std::move(space));
+}
+
+}  // namespace graph
@@ -0,0 +1,206 @@
+#pragma once
+
+#include "graph.h"
+#include "router.h"
+
+#include <algorithm>
+#include <deque>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <queue>
+#include <stdexcept>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace graph {
+
+// Builds routes on demand: the shortest-path tree of a source is computed by Dijkstra
+// on the first query from it and then cached. Construction is O(E), memory grows
+// only with the number of sources that are actually queried.
+template <typename Weight>
+class DijkstraRouter : public RouterInterface<Weight> {
+private:
+    using Graph = DirectedWeightedGraph<Weight>;
+
+public:
+    using typename RouterInterface<Weight>::RouteInfo;
+
+    // max_cached_trees == 0 means the cache is unbounded
+    explicit DijkstraRouter(const Graph& graph, size_t max_cached_trees = 0);
+
+    std::optional<RouteInfo> BuildRoute(VertexId from, VertexId to) const override;
+    std::vector<std::optional<Weight>> BuildWeights(VertexId from, const std::vector<VertexId>& targets) const override;
+
+private:
+    static constexpr EdgeId NO_EDGE = std::numeric_limits<EdgeId>::max();
+
+    struct ShortestPathTree {
+        std::vector<Weight> weights;
+        std::vector<EdgeId> prev_edges;
+        std::vector<bool> reached;
+    };
+
+    std::shared_ptr<const ShortestPathTree> GetShortestPathTree(VertexId from) const;
+    ShortestPathTree ComputeShortestPathTree(VertexId from) const;
+
+    static constexpr Weight ZERO_WEIGHT{};
+    const Graph& graph_;
+    size_t max_cached_trees_ = 0;
+
+    mutable std::mutex cache_mutex_;
+    mutable std::unordered_map<VertexId, std::shared_ptr<const ShortestPathTree>> trees_;
+    mutable std::deque<VertexId> trees_order_;
+};
+
+// Calls func(vertex, weight) for every vertex whose route from `from` weighs at most
+// max_weight, in the order of the weights. The search stops at the budget and keeps
+// no previous edges, so its cost depends on the budget and not on the graph size.
+template <typename Weight, typename Func>
+void ForEachVertexWithinWeight(const DirectedWeightedGraph<Weight>& graph, VertexId from, Weight max_weight, Func&& func) {
+    if (from >= graph.GetVertexCount()) {
+        throw std::out_of_range("Vertex id is out of range");
+    }
+    using QueueItem = std::pair<Weight, VertexId>;
+    std::priority_queue<QueueItem, std::vector<QueueItem>, std::greater<QueueItem>> queue;
+    // Only the reached vertices are kept
+    std::unordered_map<VertexId, Weight> weights;
+    weights[from] = Weight{};
+    queue.push({Weight{}, from});
+    while (!queue.empty()) {
+        const auto [weight, vertex] = queue.top();
+        queue.pop();
+        if (max_weight < weight) {
+            break;
+        }
+        // Outdated item, the vertex was pushed again with a lower weight
+        if (weights.at(vertex) < weight) {
+            continue;
+        }
+        func(vertex, weight);
+        graph.ForEachIncidentEdge(vertex, [&, weight = weight](EdgeId, VertexId to, Weight edge_weight) {
+            const Weight candidate_weight = weight + edge_weight;
+            if (max_weight < candidate_weight) {
+                return;
+            }
+            auto [it, inserted] = weights.try_emplace(to, candidate_weight);
+            if (inserted || candidate_weight < it->second) {
+                it->second = candidate_weight;
+                queue.push({candidate_weight, to});
+            }
+        });
+    }
+}
+
+template <typename Weight>
+DijkstraRouter<Weight>::DijkstraRouter(const Graph& graph, size_t max_cached_trees)
+    : graph_(graph)
+    , max_cached_trees_(max_cached_trees)
+{
+    for (EdgeId edge_id = 0; edge_id < graph.GetEdgeCount(); ++edge_id) {
+        if (graph.GetEdge(edge_id).weight < ZERO_WEIGHT) {
+            throw std::domain_error("Edges' weights should be non-negative");
+        }
+    }
+}
+
+template <typename Weight>
+std::optional<typename DijkstraRouter<Weight>::RouteInfo> DijkstraRouter<Weight>::BuildRoute(VertexId from,
+                                                                                             VertexId to) const {
+    if (from >= graph_.GetVertexCount() || to >= graph_.GetVertexCount()) {
+        throw std::out_of_range("Vertex id is out of range");
+    }
+    const auto tree = GetShortestPathTree(from);
+    if (!tree->reached[to]) {
+        return std::nullopt;
+    }
+    std::vector<EdgeId> edges;
+    for (EdgeId edge_id = tree->prev_edges[to]; edge_id != NO_EDGE;
+         edge_id = tree->prev_edges[graph_.GetEdge(edge_id).from])
+    {
+        edges.push_back(edge_id);
+    }
+    std::reverse(edges.begin(), edges.end());
+
+    return RouteInfo{tree->weights[to], std::move(edges)};
+}
+
+template <typename Weight>
+std::vector<std::optional<Weight>> DijkstraRouter<Weight>::BuildWeights(VertexId from,
+                                                                       const std::vector<VertexId>& targets) const {
+    if (from >= graph_.GetVertexCount()) {
+        throw std::out_of_range("Vertex id is out of range");
+    }
+    const auto tree = GetShortestPathTree(from);
+    std::vector<std::optional<Weight>> weights;
+    weights.reserve(targets.size());
+    for (const VertexId to : targets) {
+        if (to >= graph_.GetVertexCount()) {
+            throw std::out_of_range("Vertex id is out of range");
+        }
+        weights.push_back(tree->reached[to] ? std::optional<Weight>(tree->weights[to]) : std::nullopt);
+    }
+    return weights;
+}
+
+template <typename Weight>
+std::shared_ptr<const typename DijkstraRouter<Weight>::ShortestPathTree>
+DijkstraRouter<Weight>::GetShortestPathTree(VertexId from) const {
+    {
+        std::lock_guard guard(cache_mutex_);
+        if (auto it = trees_.find(from); it != trees_.end()) {
+            return it->second;
+        }
+    }
+    // Computed outside the lock so that queries from different sources do not wait for each other
+    auto tree = std::make_shared<const ShortestPathTree>(ComputeShortestPathTree(from));
+
+    std::lock_guard guard(cache_mutex_);
+    auto [it, inserted] = trees_.emplace(from, std::move(tree));
+    if (inserted) {
+        trees_order_.push_back(from);
+        if (max_cached_trees_ != 0 && trees_order_.size() > max_cached_trees_) {
+            trees_.erase(trees_order_.front());
+            trees_order_.pop_front();
+        }
+    }
+    return it->second;
+}
+
+template <typename Weight>
+typename DijkstraRouter<Weight>::ShortestPathTree DijkstraRouter<Weight>::ComputeShortestPathTree(VertexId from) const {
+    const size_t vertex_count = graph_.GetVertexCount();
+    ShortestPathTree tree{std::vector<Weight>(vertex_count, ZERO_WEIGHT),
+                          std::vector<EdgeId>(vertex_count, NO_EDGE),
+                          std::vector<bool>(vertex_count, false)};
+
+    using QueueItem = std::pair<Weight, VertexId>;
+    std::priority_queue<QueueItem, std::vector<QueueItem>, std::greater<QueueItem>> queue;
+    std::vector<bool> settled(vertex_count, false);
+
+    tree.reached[from] = true;
+    queue.push({ZERO_WEIGHT, from});
+    while (!queue.empty()) {
+        const auto [weight, vertex] = queue.top();
+        queue.pop();
+        if (settled[vertex]) {
+            continue;
+        }
+        settled[vertex] = true;
+        graph_.ForEachIncidentEdge(vertex, [&, weight = weight](EdgeId edge_id, VertexId to, Weight edge_weight) {
+            const Weight candidate_weight = weight + edge_weight;
+            if (!tree.reached[to] || candidate_weight < tree.weights[to]) {
+                tree.reached[to] = true;
+                tree.weights[to] = candidate_weight;
+                tree.prev_edges[to] = edge_id;
+                queue.push({candidate_weight, to});
+            }
+        });
+    }
+    return tree;
+}
+
+}  // namespace graph
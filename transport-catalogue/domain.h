@@ -1,15 +1,24 @@
 #pragma once
 
+#include <cstdint>
 #include <string>
+#include <string_view>
 #include <unordered_set>
+#include <variant>
 #include <vector>
 
 #include "geo.h"
+#include "memory_placement.h"
+
+// Dense indexes assigned by the catalogue in the order of insertion
+using StopId = uint32_t;
+using BusId = uint32_t;
 
 struct Stop{
     std::string stop_name_ = "";
     geo::Coordinates stop_coordinates_;
     std::unordered_set<std::string_view> routes_ = {};
+    StopId id_ = 0;
     bool operator==(const Stop &rhs)
     {
         return (this->stop_name_ == rhs.stop_name_) &&
@@ -36,6 +45,12 @@ struct Bus{
     std::string bus_name_ = "";
     std::vector<Stop*> route_;
     bool is_roundtrip_ = false;
+    BusId id_ = 0;
+    // Ids of the stops of route_, filled by the catalogue
+    std::vector<StopId> stop_ids_ = {};
+    // Road distance from the first stop to each stop of route_, kept up to date by the
+    // catalogue: the ride between positions i < j is the difference of the two values
+    std::vector<double> cumulative_distances_ = {};
 
     bool operator==(const Bus &rhs)
     {
@@ -62,31 +77,72 @@ struct StopInfo
     std::vector<std::string_view> route_names_;
 };
 
+enum class RoutingEngine
+{
+    ALL_PAIRS,
+    DIJKSTRA,
+    CONTRACTION_HIERARCHIES,
+    A_STAR,
+    // Multi-level partition with per-cell cliques; a weight change only re-customizes
+    OVERLAY,
+    // Pruned landmark labels; travel times are merges of two sorted label arrays
+    HUB_LABELS,
+    // Works on the bus route arrays and builds no graph
+    RAPTOR
+};
+
+// Type of the weights kept by the all-pairs table; routes are still summed in double
+enum class TableWeight
+{
+    DOUBLE,
+    FLOAT,
+    // Travel times in whole tenths of a second
+    DECISECONDS
+};
+
+// How the all-pairs table is built; both give shortest routes, but equal ones may differ
+enum class TableAlgorithm
+{
+    FLOYD_WARSHALL,
+    // A Dijkstra run per source, much faster on the sparse transport graph
+    DIJKSTRA
+};
+
 struct RouteSettings
 {
     int bus_wait_time_ = 0;
     double bus_velocity_ = 0.0;
+    RoutingEngine routing_engine_ = RoutingEngine::ALL_PAIRS;
+    // Buses are modelled by chains of riding vertices with edges between consecutive
+    // stops instead of an edge for every pair of stops: linear in the route length,
+    // but with more vertices, which the all-pairs table pays for
+    bool linear_bus_model_ = false;
+    TableWeight table_weight_ = TableWeight::DOUBLE;
+    TableAlgorithm table_algorithm_ = TableAlgorithm::FLOYD_WARSHALL;
+    // Shortest path trees the Dijkstra engine keeps, the oldest is dropped first: each
+    // takes O(V), so an unbounded cache would grow back to the all-pairs table
+    size_t dijkstra_cached_trees_ = 128;
+    // Number of built routes kept for repeated (from, to) queries, 0 disables the cache
+    size_t route_cache_size_ = 0;
+    // File the built all-pairs router or hub labels are saved to and loaded from on the next start
+    std::string routing_cache_file_;
+    // Huge pages and NUMA placement of the graph and the all-pairs table
+    memory::PlacementSettings memory_placement_;
+    // Print where that memory went once the router is built
+    bool memory_report_ = false;
 };
 
-class RouteItem {
-    public:
-        explicit RouteItem(std::string type) : type_(type) {}
-    
-        std::string type_;
-        virtual ~RouteItem() = default;
+// Items of a built route refer to the names kept by the catalogue, so a route is
+// a flat array of small values
+struct WaitRouteItem {
+    std::string_view stop_name_;
+    int time_ = 0;
 };
-    
-class WaitRouteItem : public RouteItem {
-    public:
-        WaitRouteItem() : RouteItem("Wait") {}
-        std::string stop_name_;
-        int time_;
+
+struct BusRouteItem {
+    std::string_view bus_;
+    int span_count_ = 0;
+    double time_ = 0;
 };
 
-class BusRouteItem : public RouteItem {
-    public:
-        BusRouteItem() : RouteItem("Bus") {}
-        std::string bus_;
-        int span_count_ = 0;
-        double time_ = 0;
-};
\ No newline at end of file
+using RouteItem = std::variant<WaitRouteItem, BusRouteItem>;
\ No newline at end of file
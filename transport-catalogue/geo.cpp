@@ -7,6 +7,10 @@ namespace geo {
 
 double ComputeDistance(Coordinates from, Coordinates to) {
     using namespace std;
+    // acos of a sum that rounds to just under 1 would give some centimetres otherwise
+    if (from == to) {
+        return 0;
+    }
     const double dr = M_PI / 180.0;
     return acos(sin(from.lat * dr) * sin(to.lat * dr)
                 + cos(from.lat * dr) * cos(to.lat * dr) * cos(abs(from.lng - to.lng) * dr))
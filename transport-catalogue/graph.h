@@ -1,8 +1,12 @@
 #pragma once
 
+#include "memory_placement.h"
 #include "ranges.h"
 
+#include <cstddef>
 #include <cstdlib>
+#include <iterator>
+#include <stdexcept>
 #include <vector>
 
 namespace graph {
@@ -17,25 +21,110 @@ struct Edge {
     Weight weight;
 };
 
+// Outgoing edge as it is stored in a frozen graph
+template <typename Weight>
+struct IncidentEdge {
+    VertexId to;
+    Weight weight;
+    EdgeId id;
+};
+
+// Ids of the outgoing edges of a vertex: read from its incidence list, or from the
+// packed records when the graph is frozen, which then keep the only copy of the ids
+template <typename Weight>
+class IncidentEdgeIdIterator {
+public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = EdgeId;
+    using difference_type = std::ptrdiff_t;
+    using pointer = const EdgeId*;
+    using reference = const EdgeId&;
+
+    IncidentEdgeIdIterator() = default;
+    explicit IncidentEdgeIdIterator(const EdgeId* id)
+        : id_(id) {
+    }
+    explicit IncidentEdgeIdIterator(const IncidentEdge<Weight>* record)
+        : record_(record) {
+    }
+
+    reference operator*() const {
+        return record_ ? record_->id : *id_;
+    }
+    IncidentEdgeIdIterator& operator++() {
+        if (record_) {
+            ++record_;
+        } else {
+            ++id_;
+        }
+        return *this;
+    }
+    IncidentEdgeIdIterator operator++(int) {
+        IncidentEdgeIdIterator previous = *this;
+        ++*this;
+        return previous;
+    }
+    bool operator==(const IncidentEdgeIdIterator& other) const {
+        return id_ == other.id_ && record_ == other.record_;
+    }
+    bool operator!=(const IncidentEdgeIdIterator& other) const {
+        return !(*this == other);
+    }
+
+private:
+    const EdgeId* id_ = nullptr;
+    const IncidentEdge<Weight>* record_ = nullptr;
+};
+
 template <typename Weight>
 class DirectedWeightedGraph {
 private:
     using IncidenceList = std::vector<EdgeId>;
-    using IncidentEdgesRange = ranges::Range<typename IncidenceList::const_iterator>;
+    using IncidentEdgesRange = ranges::Range<IncidentEdgeIdIterator<Weight>>;
+    using IncidentEdgeRecords = std::vector<IncidentEdge<Weight>, memory::TableAllocator<IncidentEdge<Weight>>>;
+    using IncidentEdgeRecordsRange = ranges::Range<typename IncidentEdgeRecords::const_iterator>;
 
 public:
     DirectedWeightedGraph() = default;
     explicit DirectedWeightedGraph(size_t vertex_count);
     EdgeId AddEdge(const Edge<Weight>& edge);
+    // Bulk construction: appends count edges and returns the id of the first of them.
+    // They are filled by SetEdge, which may run concurrently for different ids, and
+    // must all be set before the next AddEdge or Freeze.
+    EdgeId AllocateEdges(size_t count);
+    void SetEdge(EdgeId edge_id, const Edge<Weight>& edge);
 
     size_t GetVertexCount() const;
     size_t GetEdgeCount() const;
     const Edge<Weight>& GetEdge(EdgeId edge_id) const;
     IncidentEdgesRange GetIncidentEdges(VertexId vertex) const;
 
+    // Packs the graph into compressed sparse rows: one offsets array and contiguous
+    // (to, weight, id) records of outgoing edges. Adding an edge afterwards unpacks it back.
+    void Freeze();
+    bool IsFrozen() const;
+    // Available only for a frozen graph
+    IncidentEdgeRecordsRange GetIncidentEdgeRecords(VertexId vertex) const;
+    // Calls func(edge_id, to, weight) for every outgoing edge, reading the packed
+    // records when the graph is frozen
+    template <typename Func>
+    void ForEachIncidentEdge(VertexId vertex, Func&& func) const;
+
 private:
-    std::vector<Edge<Weight>> edges_;
+    void Thaw();
+    // Appends the allocated edges to the incidence lists
+    void IndexAllocatedEdges();
+
+    // The edges and their packed records are the big arrays of the graph, so they are
+    // placed by the memory settings
+    std::vector<Edge<Weight>, memory::TableAllocator<Edge<Weight>>> edges_;
     std::vector<IncidenceList> incidence_lists_;
+    // Edges from this id on are allocated but not in the incidence lists yet
+    EdgeId indexed_edge_count_ = 0;
+
+    bool is_frozen_ = false;
+    std::vector<size_t> offsets_;
+    IncidentEdgeRecords incident_edge_records_;
 };
 
 template <typename Weight>
@@ -45,15 +134,46 @@ DirectedWeightedGraph<Weight>::DirectedWeightedGraph(size_t vertex_count)
 
 template <typename Weight>
 EdgeId DirectedWeightedGraph<Weight>::AddEdge(const Edge<Weight>& edge) {
+    if (is_frozen_) {
+        Thaw();
+    }
+    IndexAllocatedEdges();
     edges_.push_back(edge);
     const EdgeId id = edges_.size() - 1;
     incidence_lists_.at(edge.from).push_back(id);
+    indexed_edge_count_ = edges_.size();
     return id;
 }
 
+template <typename Weight>
+EdgeId DirectedWeightedGraph<Weight>::AllocateEdges(size_t count) {
+    if (is_frozen_) {
+        Thaw();
+    }
+    const EdgeId first_id = edges_.size();
+    edges_.resize(edges_.size() + count);
+    return first_id;
+}
+
+template <typename Weight>
+void DirectedWeightedGraph<Weight>::SetEdge(EdgeId edge_id, const Edge<Weight>& edge) {
+    if (edge_id < indexed_edge_count_ || edge_id >= edges_.size() || edge.from >= incidence_lists_.size()) {
+        throw std::out_of_range("Only allocated edges can be set");
+    }
+    edges_[edge_id] = edge;
+}
+
+template <typename Weight>
+void DirectedWeightedGraph<Weight>::IndexAllocatedEdges() {
+    for (EdgeId edge_id = indexed_edge_count_; edge_id < edges_.size(); ++edge_id) {
+        incidence_lists_.at(edges_[edge_id].from).push_back(edge_id);
+    }
+    indexed_edge_count_ = edges_.size();
+}
+
 template <typename Weight>
 size_t DirectedWeightedGraph<Weight>::GetVertexCount() const {
-    return incidence_lists_.size();
+    return is_frozen_ ? offsets_.size() - 1 : incidence_lists_.size();
 }
 
 template <typename Weight>
@@ -69,6 +189,91 @@ const Edge<Weight>& DirectedWeightedGraph<Weight>::GetEdge(EdgeId edge_id) const
 template <typename Weight>
 typename DirectedWeightedGraph<Weight>::IncidentEdgesRange
 DirectedWeightedGraph<Weight>::GetIncidentEdges(VertexId vertex) const {
-    return ranges::AsRange(incidence_lists_.at(vertex));
+    using Iterator = IncidentEdgeIdIterator<Weight>;
+    if (is_frozen_) {
+        const IncidentEdge<Weight>* const records = incident_edge_records_.data();
+        return IncidentEdgesRange{Iterator(records + offsets_.at(vertex)), Iterator(records + offsets_.at(vertex + 1))};
+    }
+    if (indexed_edge_count_ != edges_.size()) {
+        throw std::logic_error("Allocated edges are traversable only after Freeze");
+    }
+    const IncidenceList& incidence_list = incidence_lists_.at(vertex);
+    return IncidentEdgesRange{Iterator(incidence_list.data()), Iterator(incidence_list.data() + incidence_list.size())};
+}
+
+template <typename Weight>
+void DirectedWeightedGraph<Weight>::Freeze() {
+    if (is_frozen_) {
+        return;
+    }
+    // Incidence lists hold the ids in increasing order, so the rows are built right from
+    // the edges by a counting sort; this also covers the allocated edges
+    const size_t vertex_count = incidence_lists_.size();
+    offsets_.assign(vertex_count + 1, 0);
+    for (const Edge<Weight>& edge : edges_) {
+        ++offsets_[edge.from + 1];
+    }
+    for (VertexId vertex = 0; vertex < vertex_count; ++vertex) {
+        offsets_[vertex + 1] += offsets_[vertex];
+    }
+    incident_edge_records_.resize(edges_.size());
+    std::vector<size_t> positions(offsets_.begin(), offsets_.end() - 1);
+    // Edges of a vertex keep the order of addition, so traversals do not change
+    for (EdgeId edge_id = 0; edge_id < edges_.size(); ++edge_id) {
+        const size_t position = positions[edges_[edge_id].from]++;
+        incident_edge_records_[position] = {edges_[edge_id].to, edges_[edge_id].weight, edge_id};
+    }
+    incidence_lists_.clear();
+    incidence_lists_.shrink_to_fit();
+    indexed_edge_count_ = edges_.size();
+    is_frozen_ = true;
+}
+
+template <typename Weight>
+bool DirectedWeightedGraph<Weight>::IsFrozen() const {
+    return is_frozen_;
+}
+
+template <typename Weight>
+typename DirectedWeightedGraph<Weight>::IncidentEdgeRecordsRange
+DirectedWeightedGraph<Weight>::GetIncidentEdgeRecords(VertexId vertex) const {
+    if (!is_frozen_) {
+        throw std::logic_error("Incident edge records are available only for a frozen graph");
+    }
+    return ranges::Range{incident_edge_records_.begin() + offsets_.at(vertex),
+                         incident_edge_records_.begin() + offsets_.at(vertex + 1)};
+}
+
+template <typename Weight>
+template <typename Func>
+void DirectedWeightedGraph<Weight>::ForEachIncidentEdge(VertexId vertex, Func&& func) const {
+    if (is_frozen_) {
+        for (size_t i = offsets_[vertex]; i < offsets_[vertex + 1]; ++i) {
+            const IncidentEdge<Weight>& record = incident_edge_records_[i];
+            func(record.id, record.to, record.weight);
+        }
+    } else {
+        if (indexed_edge_count_ != edges_.size()) {
+            throw std::logic_error("Allocated edges are traversable only after Freeze");
+        }
+        for (const EdgeId edge_id : incidence_lists_.at(vertex)) {
+            const Edge<Weight>& edge = edges_[edge_id];
+            func(edge_id, edge.to, edge.weight);
+        }
+    }
+}
+
+template <typename Weight>
+void DirectedWeightedGraph<Weight>::Thaw() {
+    const size_t vertex_count = offsets_.size() - 1;
+    incidence_lists_.assign(vertex_count, {});
+    for (VertexId vertex = 0; vertex < vertex_count; ++vertex) {
+        for (size_t i = offsets_[vertex]; i < offsets_[vertex + 1]; ++i) {
+            incidence_lists_[vertex].push_back(incident_edge_records_[i].id);
+        }
+    }
+    offsets_.clear();
+    incident_edge_records_.clear();
+    is_frozen_ = false;
 }
 }  // namespace graph
\ No newline at end of file
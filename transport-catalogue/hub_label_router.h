@@ -0,0 +1,396 @@
+#pragma once
+
+#include "graph.h"
+#include "router.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <optional>
+#include <queue>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+namespace graph {
+
+// Labels of all the vertices in CSR form: the entries of vertex v are
+// [offsets[v], offsets[v + 1]), sorted by the rank of the hub
+template <typename Weight>
+struct HubLabels {
+    std::vector<uint64_t> offsets;
+    std::vector<uint32_t> hubs;
+    std::vector<Weight> weights;
+    // First edge of the route to the hub for out-labels, last edge of the route from
+    // the hub for in-labels
+    std::vector<EdgeId> edges;
+};
+
+// Hub labeling built by pruned landmark labeling. Every vertex keeps the weights of the
+// routes to (out-label) and from (in-label) a small set of hubs, so that any shortest
+// route passes through a hub common to both ends. A weight query is a merge of two
+// sorted arrays; a route is unpacked by following the label edges to the hub.
+template <typename Weight>
+class HubLabelRouter : public RouterInterface<Weight> {
+private:
+    using Graph = DirectedWeightedGraph<Weight>;
+
+public:
+    using typename RouterInterface<Weight>::RouteInfo;
+
+    explicit HubLabelRouter(const Graph& graph);
+    // Takes labels built earlier for the same graph, e.g. loaded from a file
+    HubLabelRouter(const Graph& graph, std::vector<VertexId> hub_vertices, HubLabels<Weight> out_labels,
+                   HubLabels<Weight> in_labels);
+
+    std::optional<RouteInfo> BuildRoute(VertexId from, VertexId to) const override;
+    std::vector<std::optional<Weight>> BuildWeights(VertexId from, const std::vector<VertexId>& targets) const override;
+    std::optional<Weight> GetWeight(VertexId from, VertexId to) const;
+
+    // Vertices in the order of their ranks
+    const std::vector<VertexId>& GetHubVertices() const;
+    const HubLabels<Weight>& GetOutLabels() const;
+    const HubLabels<Weight>& GetInLabels() const;
+
+private:
+    static constexpr uint32_t NO_HUB = std::numeric_limits<uint32_t>::max();
+    static constexpr EdgeId NO_EDGE = std::numeric_limits<EdgeId>::max();
+    static constexpr Weight UNREACHABLE = std::numeric_limits<Weight>::has_infinity
+                                              ? std::numeric_limits<Weight>::infinity()
+                                              : std::numeric_limits<Weight>::max();
+
+    struct LabelEntry {
+        uint32_t hub;
+        Weight weight;
+        EdgeId edge;
+    };
+    using Label = std::vector<LabelEntry>;
+
+    using QueueItem = std::pair<Weight, VertexId>;
+    using Queue = std::priority_queue<QueueItem, std::vector<QueueItem>, std::greater<QueueItem>>;
+
+    void BuildLabels();
+    // Pruned Dijkstra from the hub of the rank: forward along the edges fills in-labels,
+    // backward along reversed edges fills out-labels. A vertex whose weight the labels
+    // built so far already give is neither labeled nor expanded.
+    void RunPrunedSearch(uint32_t rank, bool is_forward, std::vector<Label>& out_labels, std::vector<Label>& in_labels,
+                         std::vector<Weight>& hub_weights, std::vector<Weight>& weights, std::vector<EdgeId>& parent_edges,
+                         std::vector<uint32_t>& stamps, uint32_t stamp) const;
+    static HubLabels<Weight> Flatten(const std::vector<Label>& labels);
+    // Labels that come from outside must hold what the queries rely on: the hubs are a
+    // permutation of the vertices, every label is sorted by hub, and the edge of an entry
+    // leaves (out-label) or enters (in-label) the labeled vertex, or is NO_EDGE at the hub
+    void CheckLabels() const;
+    bool AreValidLabels(const HubLabels<Weight>& labels, bool is_out) const;
+
+    // Best common hub of the labels, NO_HUB if there is none
+    std::pair<uint32_t, Weight> FindHub(VertexId from, VertexId to) const;
+    // Position of the hub in the label of the vertex
+    uint64_t FindEntry(const HubLabels<Weight>& labels, VertexId vertex, uint32_t hub) const;
+
+    static constexpr Weight ZERO_WEIGHT{};
+    const Graph& graph_;
+    // Edges entering every vertex, for the backward searches
+    std::vector<size_t> in_edge_offsets_;
+    std::vector<EdgeId> in_edges_;
+    std::vector<VertexId> hub_vertices_;
+    HubLabels<Weight> out_labels_;
+    HubLabels<Weight> in_labels_;
+};
+
+template <typename Weight>
+HubLabelRouter<Weight>::HubLabelRouter(const Graph& graph)
+    : graph_(graph)
+{
+    const size_t vertex_count = graph.GetVertexCount();
+    in_edge_offsets_.assign(vertex_count + 1, 0);
+    std::vector<size_t> degrees(vertex_count, 0);
+    for (EdgeId edge_id = 0; edge_id < graph.GetEdgeCount(); ++edge_id) {
+        const auto& edge = graph.GetEdge(edge_id);
+        if (edge.weight < ZERO_WEIGHT) {
+            throw std::domain_error("Edges' weights should be non-negative");
+        }
+        ++in_edge_offsets_[edge.to + 1];
+        ++degrees[edge.from];
+        ++degrees[edge.to];
+    }
+    for (size_t vertex = 0; vertex < vertex_count; ++vertex) {
+        in_edge_offsets_[vertex + 1] += in_edge_offsets_[vertex];
+    }
+    in_edges_.resize(graph.GetEdgeCount());
+    std::vector<size_t> positions(in_edge_offsets_.begin(), in_edge_offsets_.end() - 1);
+    for (EdgeId edge_id = 0; edge_id < graph.GetEdgeCount(); ++edge_id) {
+        in_edges_[positions[graph.GetEdge(edge_id).to]++] = edge_id;
+    }
+
+    // Vertices with more edges lie on more routes, so they become hubs first
+    hub_vertices_.resize(vertex_count);
+    for (VertexId vertex = 0; vertex < vertex_count; ++vertex) {
+        hub_vertices_[vertex] = vertex;
+    }
+    std::stable_sort(hub_vertices_.begin(), hub_vertices_.end(), [&degrees](VertexId lhs, VertexId rhs) {
+        return degrees[lhs] > degrees[rhs];
+    });
+    BuildLabels();
+}
+
+template <typename Weight>
+HubLabelRouter<Weight>::HubLabelRouter(const Graph& graph, std::vector<VertexId> hub_vertices, HubLabels<Weight> out_labels,
+                                       HubLabels<Weight> in_labels)
+    : graph_(graph)
+    , hub_vertices_(std::move(hub_vertices))
+    , out_labels_(std::move(out_labels))
+    , in_labels_(std::move(in_labels))
+{
+    CheckLabels();
+}
+
+template <typename Weight>
+void HubLabelRouter<Weight>::BuildLabels() {
+    const size_t vertex_count = graph_.GetVertexCount();
+    std::vector<Label> out_labels(vertex_count);
+    std::vector<Label> in_labels(vertex_count);
+    // Weights between the current hub and the earlier ones, indexed by rank
+    std::vector<Weight> hub_weights(vertex_count, UNREACHABLE);
+    std::vector<Weight> weights(vertex_count);
+    std::vector<EdgeId> parent_edges(vertex_count, NO_EDGE);
+    std::vector<uint32_t> stamps(vertex_count, 0);
+    uint32_t stamp = 0;
+    for (uint32_t rank = 0; rank < vertex_count; ++rank) {
+        RunPrunedSearch(rank, true, out_labels, in_labels, hub_weights, weights, parent_edges, stamps, ++stamp);
+        RunPrunedSearch(rank, false, out_labels, in_labels, hub_weights, weights, parent_edges, stamps, ++stamp);
+    }
+    out_labels_ = Flatten(out_labels);
+    in_labels_ = Flatten(in_labels);
+}
+
+template <typename Weight>
+void HubLabelRouter<Weight>::RunPrunedSearch(uint32_t rank, bool is_forward, std::vector<Label>& out_labels,
+                                             std::vector<Label>& in_labels, std::vector<Weight>& hub_weights,
+                                             std::vector<Weight>& weights, std::vector<EdgeId>& parent_edges,
+                                             std::vector<uint32_t>& stamps, uint32_t stamp) const {
+    const VertexId root = hub_vertices_[rank];
+    // Forward search labels the routes root -> vertex: they are covered by a hub h with
+    // weights root -> h (the out-label of the root) and h -> vertex (the in-label of the vertex)
+    const Label& root_label = is_forward ? out_labels[root] : in_labels[root];
+    std::vector<Label>& labels = is_forward ? in_labels : out_labels;
+    for (const LabelEntry& entry : root_label) {
+        hub_weights[entry.hub] = entry.weight;
+    }
+
+    Queue queue;
+    stamps[root] = stamp;
+    weights[root] = ZERO_WEIGHT;
+    parent_edges[root] = NO_EDGE;
+    queue.push({ZERO_WEIGHT, root});
+    while (!queue.empty()) {
+        const auto [weight, vertex] = queue.top();
+        queue.pop();
+        if (weights[vertex] < weight) {
+            continue;
+        }
+        const bool is_covered = vertex != root && std::any_of(labels[vertex].begin(), labels[vertex].end(), [&](const LabelEntry& entry) {
+            return hub_weights[entry.hub] != UNREACHABLE && hub_weights[entry.hub] + entry.weight <= weight;
+        });
+        if (is_covered) {
+            continue;
+        }
+        labels[vertex].push_back({rank, weight, parent_edges[vertex]});
+
+        auto relax = [&](EdgeId edge_id, VertexId next, Weight edge_weight) {
+            const Weight next_weight = weight + edge_weight;
+            if (stamps[next] != stamp || next_weight < weights[next]) {
+                stamps[next] = stamp;
+                weights[next] = next_weight;
+                parent_edges[next] = edge_id;
+                queue.push({next_weight, next});
+            }
+        };
+        if (is_forward) {
+            graph_.ForEachIncidentEdge(vertex, relax);
+        } else {
+            for (size_t i = in_edge_offsets_[vertex]; i < in_edge_offsets_[vertex + 1]; ++i) {
+                const auto& edge = graph_.GetEdge(in_edges_[i]);
+                relax(in_edges_[i], edge.from, edge.weight);
+            }
+        }
+    }
+
+    for (const LabelEntry& entry : root_label) {
+        hub_weights[entry.hub] = UNREACHABLE;
+    }
+}
+
+template <typename Weight>
+HubLabels<Weight> HubLabelRouter<Weight>::Flatten(const std::vector<Label>& labels) {
+    HubLabels<Weight> result;
+    result.offsets.reserve(labels.size() + 1);
+    result.offsets.push_back(0);
+    for (const Label& label : labels) {
+        for (const LabelEntry& entry : label) {
+            result.hubs.push_back(entry.hub);
+            result.weights.push_back(entry.weight);
+            result.edges.push_back(entry.edge);
+        }
+        result.offsets.push_back(result.hubs.size());
+    }
+    return result;
+}
+
+template <typename Weight>
+void HubLabelRouter<Weight>::CheckLabels() const {
+    const size_t vertex_count = graph_.GetVertexCount();
+    bool is_valid = hub_vertices_.size() == vertex_count;
+    std::vector<bool> is_hub(vertex_count, false);
+    for (size_t rank = 0; is_valid && rank < vertex_count; ++rank) {
+        const VertexId vertex = hub_vertices_[rank];
+        is_valid = vertex < vertex_count && !is_hub[vertex];
+        if (is_valid) {
+            is_hub[vertex] = true;
+        }
+    }
+    if (!is_valid || !AreValidLabels(out_labels_, true) || !AreValidLabels(in_labels_, false)) {
+        throw std::invalid_argument("Hub labels do not match the graph");
+    }
+}
+
+template <typename Weight>
+bool HubLabelRouter<Weight>::AreValidLabels(const HubLabels<Weight>& labels, bool is_out) const {
+    const size_t vertex_count = graph_.GetVertexCount();
+    if (labels.offsets.size() != vertex_count + 1 || labels.offsets.front() != 0
+        || labels.offsets.back() != labels.hubs.size() || labels.weights.size() != labels.hubs.size()
+        || labels.edges.size() != labels.hubs.size() || !std::is_sorted(labels.offsets.begin(), labels.offsets.end())) {
+        return false;
+    }
+    for (VertexId vertex = 0; vertex < vertex_count; ++vertex) {
+        for (uint64_t i = labels.offsets[vertex]; i < labels.offsets[vertex + 1]; ++i) {
+            const uint32_t hub = labels.hubs[i];
+            const EdgeId edge = labels.edges[i];
+            if (hub >= vertex_count || (i > labels.offsets[vertex] && labels.hubs[i - 1] >= hub)) {
+                return false;
+            }
+            if (edge == NO_EDGE) {
+                if (hub_vertices_[hub] != vertex) {
+                    return false;
+                }
+            } else if (edge >= graph_.GetEdgeCount()
+                       || (is_out ? graph_.GetEdge(edge).from : graph_.GetEdge(edge).to) != vertex) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+template <typename Weight>
+std::pair<uint32_t, Weight> HubLabelRouter<Weight>::FindHub(VertexId from, VertexId to) const {
+    uint64_t out = out_labels_.offsets[from];
+    const uint64_t out_end = out_labels_.offsets[from + 1];
+    uint64_t in = in_labels_.offsets[to];
+    const uint64_t in_end = in_labels_.offsets[to + 1];
+    std::pair<uint32_t, Weight> best{NO_HUB, UNREACHABLE};
+    while (out < out_end && in < in_end) {
+        if (out_labels_.hubs[out] < in_labels_.hubs[in]) {
+            ++out;
+        } else if (in_labels_.hubs[in] < out_labels_.hubs[out]) {
+            ++in;
+        } else {
+            const Weight weight = out_labels_.weights[out] + in_labels_.weights[in];
+            if (best.first == NO_HUB || weight < best.second) {
+                best = {out_labels_.hubs[out], weight};
+            }
+            ++out;
+            ++in;
+        }
+    }
+    return best;
+}
+
+template <typename Weight>
+uint64_t HubLabelRouter<Weight>::FindEntry(const HubLabels<Weight>& labels, VertexId vertex, uint32_t hub) const {
+    const auto begin = labels.hubs.begin() + labels.offsets[vertex];
+    const auto end = labels.hubs.begin() + labels.offsets[vertex + 1];
+    const auto it = std::lower_bound(begin, end, hub);
+    if (it == end || *it != hub) {
+        throw std::logic_error("Hub label chain is broken");
+    }
+    return static_cast<uint64_t>(it - labels.hubs.begin());
+}
+
+template <typename Weight>
+std::optional<Weight> HubLabelRouter<Weight>::GetWeight(VertexId from, VertexId to) const {
+    if (from >= graph_.GetVertexCount() || to >= graph_.GetVertexCount()) {
+        throw std::out_of_range("Vertex id is out of range");
+    }
+    if (from == to) {
+        return ZERO_WEIGHT;
+    }
+    const auto [hub, weight] = FindHub(from, to);
+    if (hub == NO_HUB) {
+        return std::nullopt;
+    }
+    return weight;
+}
+
+template <typename Weight>
+std::vector<std::optional<Weight>> HubLabelRouter<Weight>::BuildWeights(VertexId from, const std::vector<VertexId>& targets) const {
+    std::vector<std::optional<Weight>> weights;
+    weights.reserve(targets.size());
+    for (const VertexId to : targets) {
+        weights.push_back(GetWeight(from, to));
+    }
+    return weights;
+}
+
+template <typename Weight>
+std::optional<typename HubLabelRouter<Weight>::RouteInfo> HubLabelRouter<Weight>::BuildRoute(VertexId from, VertexId to) const {
+    const std::optional<Weight> weight = GetWeight(from, to);
+    if (!weight) {
+        return std::nullopt;
+    }
+    RouteInfo route{*weight, {}};
+    if (from == to) {
+        return route;
+    }
+    const uint32_t hub = FindHub(from, to).first;
+    const VertexId hub_vertex = hub_vertices_[hub];
+    // Each half of a shortest route visits a vertex at most once; a longer chain means
+    // labels that contradict each other, and following it would never end
+    auto check_length = [this, &route]() {
+        if (route.edges.size() > graph_.GetVertexCount()) {
+            throw std::logic_error("Hub label chain is broken");
+        }
+    };
+    for (VertexId vertex = from; vertex != hub_vertex;) {
+        const EdgeId edge = out_labels_.edges[FindEntry(out_labels_, vertex, hub)];
+        route.edges.push_back(edge);
+        check_length();
+        vertex = graph_.GetEdge(edge).to;
+    }
+    const size_t first_in_edge = route.edges.size();
+    for (VertexId vertex = to; vertex != hub_vertex;) {
+        const EdgeId edge = in_labels_.edges[FindEntry(in_labels_, vertex, hub)];
+        route.edges.push_back(edge);
+        check_length();
+        vertex = graph_.GetEdge(edge).from;
+    }
+    std::reverse(route.edges.begin() + first_in_edge, route.edges.end());
+    return route;
+}
+
+template <typename Weight>
+const std::vector<VertexId>& HubLabelRouter<Weight>::GetHubVertices() const {
+    return hub_vertices_;
+}
+
+template <typename Weight>
+const HubLabels<Weight>& HubLabelRouter<Weight>::GetOutLabels() const {
+    return out_labels_;
+}
+
+template <typename Weight>
+const HubLabels<Weight>& HubLabelRouter<Weight>::GetInLabels() const {
+    return in_labels_;
+}
+
+}  // namespace graph
@@ -1,5 +1,8 @@
 #include "json_reader.h"
+#include <algorithm>
+#include <iostream>
 #include <sstream>
+#include <stdexcept>
 
 void InputReader::FormCatalogue(std::istream& input, transport_catalogue::TransportCatalogue& catalogue, 
                                 map_render::RenderSettings* settings, transport_router::Router& router) {
@@ -101,6 +104,28 @@ void InputReader::ParseJsonStatRequests(std::queue<std::unique_ptr<RequestDescri
                 req_des->to = req_dict.AsMap().at("to"s).AsString();
                 requests.push(std::move(req_des));
             }
+            else if (req_dict.AsMap().at("type").AsString() == "TravelTimeMatrix"){
+                auto req_des = std::make_unique<TravelTimeMatrixRequestDescription>();
+                req_des->id_ = req_dict.AsMap().at("id"s).AsInt();
+                req_des->type_ = req_dict.AsMap().at("type"s).AsString();
+                for(auto& stop_node : req_dict.AsMap().at("from"s).AsArray())
+                {
+                    req_des->from_.push_back(stop_node.AsString());
+                }
+                for(auto& stop_node : req_dict.AsMap().at("to"s).AsArray())
+                {
+                    req_des->to_.push_back(stop_node.AsString());
+                }
+                requests.push(std::move(req_des));
+            }
+            else if (req_dict.AsMap().at("type").AsString() == "Isochrone"){
+                auto req_des = std::make_unique<IsochroneRequestDescription>();
+                req_des->id_ = req_dict.AsMap().at("id"s).AsInt();
+                req_des->type_ = req_dict.AsMap().at("type"s).AsString();
+                req_des->from_ = req_dict.AsMap().at("from"s).AsString();
+                req_des->max_time_ = req_dict.AsMap().at("max_time"s).AsDouble();
+                requests.push(std::move(req_des));
+            }
         }
     }
 }
@@ -166,6 +191,108 @@ void InputReader::ParseJsonRenderSettings(map_render::RenderSettings* settings)
     }
 }
 
+RoutingEngine ConvertNodeToRoutingEngine(const json::Node& node)
+{
+    using namespace std::literals;
+    if(node.AsString() == "dijkstra"s)
+    {
+        return RoutingEngine::DIJKSTRA;
+    }
+    else if(node.AsString() == "contraction_hierarchies"s)
+    {
+        return RoutingEngine::CONTRACTION_HIERARCHIES;
+    }
+    else if(node.AsString() == "a_star"s)
+    {
+        return RoutingEngine::A_STAR;
+    }
+    else if(node.AsString() == "overlay"s)
+    {
+        return RoutingEngine::OVERLAY;
+    }
+    else if(node.AsString() == "hub_labels"s)
+    {
+        return RoutingEngine::HUB_LABELS;
+    }
+    else if(node.AsString() == "raptor"s)
+    {
+        return RoutingEngine::RAPTOR;
+    }
+    else if(node.AsString() == "all_pairs"s)
+    {
+        return RoutingEngine::ALL_PAIRS;
+    }
+    throw std::invalid_argument("Unknown routing engine: "s + node.AsString());
+}
+
+TableWeight ConvertNodeToTableWeight(const json::Node& node)
+{
+    using namespace std::literals;
+    if(node.AsString() == "double"s)
+    {
+        return TableWeight::DOUBLE;
+    }
+    else if(node.AsString() == "float"s)
+    {
+        return TableWeight::FLOAT;
+    }
+    else if(node.AsString() == "deciseconds"s)
+    {
+        return TableWeight::DECISECONDS;
+    }
+    throw std::invalid_argument("Unknown routing table weight: "s + node.AsString());
+}
+
+TableAlgorithm ConvertNodeToTableAlgorithm(const json::Node& node)
+{
+    using namespace std::literals;
+    if(node.AsString() == "floyd_warshall"s)
+    {
+        return TableAlgorithm::FLOYD_WARSHALL;
+    }
+    else if(node.AsString() == "dijkstra"s)
+    {
+        return TableAlgorithm::DIJKSTRA;
+    }
+    throw std::invalid_argument("Unknown routing table algorithm: "s + node.AsString());
+}
+
+memory::HugePages ConvertNodeToHugePages(const json::Node& node)
+{
+    using namespace std::literals;
+    if(node.AsString() == "none"s)
+    {
+        return memory::HugePages::NONE;
+    }
+    else if(node.AsString() == "transparent"s)
+    {
+        return memory::HugePages::TRANSPARENT;
+    }
+    else if(node.AsString() == "explicit"s)
+    {
+        return memory::HugePages::EXPLICIT;
+    }
+    throw std::invalid_argument("Unknown huge pages mode: "s + node.AsString());
+}
+
+memory::NumaPolicy ConvertNodeToNumaPolicy(const json::Node& node)
+{
+    using namespace std::literals;
+    if(node.AsString() == "first_touch"s)
+    {
+        return memory::NumaPolicy::FIRST_TOUCH;
+    }
+    else if(node.AsString() == "interleave"s)
+    {
+        return memory::NumaPolicy::INTERLEAVE;
+    }
+    else if(node.AsString() == "replicate"s)
+    {
+        return memory::NumaPolicy::REPLICATE;
+    }
+    throw std::invalid_argument("Unknown NUMA policy: "s + node.AsString());
+}
+
 void InputReader::ParseJsonRouterSettings(transport_router::Router& router)
 {
     using namespace std::literals;
@@ -175,6 +302,52 @@ void InputReader::ParseJsonRouterSettings(transport_router::Router& router)
         int bus_wait_time = req_dict.AsMap().at("bus_wait_time"s).AsInt();
         double bus_velocity = req_dict.AsMap().at("bus_velocity"s).AsDouble();
         router.SetRouteSettings(bus_wait_time, bus_velocity);
+        if(req_dict.AsMap().count("routing_engine"s))
+        {
+            router.SetRoutingEngine(ConvertNodeToRoutingEngine(req_dict.AsMap().at("routing_engine"s)));
+        }
+        if(req_dict.AsMap().count("linear_bus_model"s))
+        {
+            router.SetLinearBusModel(req_dict.AsMap().at("linear_bus_model"s).AsBool());
+        }
+        if(req_dict.AsMap().count("compact_routing_table"s))
+        {
+            router.SetCompactRoutingTable(req_dict.AsMap().at("compact_routing_table"s).AsBool());
+        }
+        if(req_dict.AsMap().count("routing_table_weight"s))
+        {
+            router.SetTableWeight(ConvertNodeToTableWeight(req_dict.AsMap().at("routing_table_weight"s)));
+        }
+        if(req_dict.AsMap().count("routing_table_algorithm"s))
+        {
+            router.SetTableAlgorithm(ConvertNodeToTableAlgorithm(req_dict.AsMap().at("routing_table_algorithm"s)));
+        }
+        if(req_dict.AsMap().count("route_cache_size"s))
+        {
+            router.SetRouteCacheSize(static_cast<size_t>(req_dict.AsMap().at("route_cache_size"s).AsInt()));
+        }
+        if(req_dict.AsMap().count("dijkstra_cached_trees"s))
+        {
+            router.SetDijkstraCachedTrees(static_cast<size_t>(req_dict.AsMap().at("dijkstra_cached_trees"s).AsInt()));
+        }
+        if(req_dict.AsMap().count("routing_cache_file"s))
+        {
+            router.SetRoutingCacheFile(req_dict.AsMap().at("routing_cache_file"s).AsString());
+        }
+        memory::PlacementSettings placement;
+        if(req_dict.AsMap().count("huge_pages"s))
+        {
+            placement.huge_pages_ = ConvertNodeToHugePages(req_dict.AsMap().at("huge_pages"s));
+        }
+        if(req_dict.AsMap().count("numa_policy"s))
+        {
+            placement.numa_policy_ = ConvertNodeToNumaPolicy(req_dict.AsMap().at("numa_policy"s));
+        }
+        router.SetMemoryPlacement(placement);
+        if(req_dict.AsMap().count("memory_report"s))
+        {
+            router.SetMemoryReport(req_dict.AsMap().at("memory_report"s).AsBool());
+        }
     }
 }
 
@@ -198,7 +371,10 @@ void InputReader::ApplyCommands(transport_catalogue::TransportCatalogue& catalog
                                                 static_cast<BusReadCommand*>(bus_comand.get())->is_round_trip);
     }
     router.FormGraph(catalogue);
-
+    if(router.GetRouteSettings().memory_report_)
+    {
+        router.ReportMemoryPlacement(std::cerr);
+    }
 }
 
 void StatAnswer::HandleRequests(std::ostream& output, std::queue<std::unique_ptr<RequestDescription>>& requests, 
@@ -259,8 +435,18 @@ void StatAnswer::HandleRequests(std::ostream& output, std::queue<std::unique_ptr
         else if(requests.front()->type_ == "Route"s)
         {
             auto req_ptr = dynamic_cast<RouteRequestDescription*>(requests.front().get());
-            auto router_info = router.BuildRoute(req_ptr->from, req_ptr->to);
-            if(!router_info)
+            std::shared_ptr<const transport_router::BuildedRoute> cached_route;
+            const transport_router::BuildedRoute* route = nullptr;
+            if(router.GetRouteSettings().route_cache_size_ > 0)
+            {
+                cached_route = router.GetRoute(req_ptr->from, req_ptr->to);
+                route = cached_route.get();
+            }
+            else if(router.BuildRoute(req_ptr->from, req_ptr->to, route_buffer_))
+            {
+                route = &route_buffer_;
+            }
+            if(!route)
             {
                 AnswerError ans_error("not found"s);
                 ans_error.request_id_ = requests.front()->id_;
@@ -270,17 +456,57 @@ void StatAnswer::HandleRequests(std::ostream& output, std::queue<std::unique_ptr
             {
                 AnswerRoute ans_route;
                 ans_route.request_id_ = requests.front()->id_;
-                ans_route.total_time_ = router_info.value().total_weight_;
-                ans_route.items_ = std::move(router_info.value().items_);
+                ans_route.route_ = route;
                 AddAnswerToArr(&ans_route);
             }
         }
+        else if(requests.front()->type_ == "TravelTimeMatrix"s)
+        {
+            auto req_ptr = dynamic_cast<TravelTimeMatrixRequestDescription*>(requests.front().get());
+            AnswerTravelTimeMatrix ans_matrix;
+            ans_matrix.request_id_ = requests.front()->id_;
+            ans_matrix.times_ = router.BuildTravelTimeMatrix(std::vector<std::string_view>(req_ptr->from_.begin(), req_ptr->from_.end()),
+                                                             std::vector<std::string_view>(req_ptr->to_.begin(), req_ptr->to_.end()));
+            AddAnswerToArr(&ans_matrix);
+        }
+        else if(requests.front()->type_ == "Isochrone"s)
+        {
+            auto req_ptr = dynamic_cast<IsochroneRequestDescription*>(requests.front().get());
+            AnswerIsochrone ans_isochrone;
+            ans_isochrone.request_id_ = requests.front()->id_;
+            router.ForEachReachableStop(req_ptr->from_, req_ptr->max_time_, [&ans_isochrone](std::string_view stop_name, double time) {
+                ans_isochrone.stops_.emplace_back(stop_name, time);
+            });
+            std::sort(ans_isochrone.stops_.begin(), ans_isochrone.stops_.end(), [](const auto& lhs, const auto& rhs) {
+                return lhs.second < rhs.second || (lhs.second == rhs.second && lhs.first < rhs.first);
+            });
+            AddAnswerToArr(&ans_isochrone);
+        }
         requests.pop();
     }
     builder_.EndArray();
     json::Print(json::Document{builder_.Build()}, output);
 }
 
+void StatAnswer::AddRouteItemToArr(const WaitRouteItem& item) {
+    using namespace std::literals;
+    builder_.StartDict()
+            .Key("stop_name"s).Value(std::string(item.stop_name_))
+            .Key("time"s).Value(item.time_)
+            .Key("type"s).Value("Wait"s)
+            .EndDict();
+}
+
+void StatAnswer::AddRouteItemToArr(const BusRouteItem& item) {
+    using namespace std::literals;
+    builder_.StartDict()
+            .Key("bus"s).Value(std::string(item.bus_))
+            .Key("span_count"s).Value(item.span_count_)
+            .Key("time"s).Value(item.time_)
+            .Key("type"s).Value("Bus"s)
+            .EndDict();
+}
+
 void StatAnswer::AddAnswerToArr(AnswerDescription* answer) {
     using namespace std::literals;
     using namespace json;
@@ -318,29 +544,52 @@ void StatAnswer::AddAnswerToArr(AnswerDescription* answer) {
         builder_.StartDict()
                 .Key("items").StartArray();
         auto answ = static_cast<AnswerRoute*>(answer);
-        for(size_t i = 0; i < answ->items_.size(); ++i)
+        for(const auto& item : answ->route_->items_)
         {
-            builder_.StartDict();
-            if(answ->items_.at(i)->type_ == "Wait")
-            {
-                auto wait_route_item = static_cast<WaitRouteItem*>(answ->items_.at(i).get());
-                builder_.Key("stop_name"s).Value(wait_route_item->stop_name_)
-                        .Key("time"s).Value(wait_route_item->time_)
-                        .Key("type"s).Value("Wait"s);
-            }
-            else
-            {
-                auto bus_route_item = static_cast<BusRouteItem*>(answ->items_.at(i).get());
-                builder_.Key("bus"s).Value(bus_route_item->bus_)
-                        .Key("span_count"s).Value(bus_route_item->span_count_)
-                        .Key("time"s).Value(bus_route_item->time_)
-                        .Key("type"s).Value("Bus"s);
-            }
-            builder_.EndDict();
+            std::visit([this](const auto& route_item) { AddRouteItemToArr(route_item); }, item);
         }
         builder_.EndArray();
         builder_.Key("request_id"s).Value(answ->request_id_)
-                .Key("total_time"s).Value(answ->total_time_)
+                .Key("total_time"s).Value(answ->route_->total_weight_)
+                .EndDict();
+    }
+    else if (answer->type_ == "TravelTimeMatrix"s)
+    {
+        builder_.StartDict()
+                .Key("request_id"s).Value(answer->request_id_)
+                .Key("times"s).StartArray();
+        for(const auto& row : static_cast<AnswerTravelTimeMatrix*>(answer)->times_)
+        {
+            builder_.StartArray();
+            for(const auto& time : row)
+            {
+                if(time)
+                {
+                    builder_.Value(*time);
+                }
+                else
+                {
+                    builder_.Value(nullptr);
+                }
+            }
+            builder_.EndArray();
+        }
+        builder_.EndArray()
+                .EndDict();
+    }
+    else if (answer->type_ == "Isochrone"s)
+    {
+        builder_.StartDict()
+                .Key("request_id"s).Value(answer->request_id_)
+                .Key("stops"s).StartArray();
+        for(const auto& [stop_name, time] : static_cast<AnswerIsochrone*>(answer)->stops_)
+        {
+            builder_.StartDict()
+                    .Key("stop_name"s).Value(std::string(stop_name))
+                    .Key("time"s).Value(time)
+                    .EndDict();
+        }
+        builder_.EndArray()
                 .EndDict();
     }
     else
@@ -77,6 +77,18 @@ private:
     std::unique_ptr<json::Document> doc_;
 };
 
+class TravelTimeMatrixRequestDescription : public RequestDescription {
+public:
+    std::vector<std::string> from_;
+    std::vector<std::string> to_;
+};
+
+class IsochroneRequestDescription : public RequestDescription {
+public:
+    std::string from_;
+    double max_time_ = 0.0;
+};
+
 class AnswerDescription {
 public:
     explicit AnswerDescription(std::string type) : type_(type) {}
@@ -118,8 +130,21 @@ public:
 class AnswerRoute : public AnswerDescription {
 public:
     AnswerRoute() : AnswerDescription("Route") {}
-    double total_time_ = 0.0;
-    std::vector<std::unique_ptr<RouteItem>> items_;
+    // Points either to a cached route or to the route buffer of StatAnswer
+    const transport_router::BuildedRoute* route_ = nullptr;
+};
+
+class AnswerTravelTimeMatrix : public AnswerDescription {
+public:
+    AnswerTravelTimeMatrix() : AnswerDescription("TravelTimeMatrix") {}
+    std::vector<std::vector<std::optional<double>>> times_;
+};
+
+class AnswerIsochrone : public AnswerDescription {
+public:
+    AnswerIsochrone() : AnswerDescription("Isochrone") {}
+    // Reached stops with their times, ordered by the time and then by the name
+    std::vector<std::pair<std::string_view, double>> stops_;
 };
 
 class StatAnswer : public OutputInterface {
@@ -129,6 +154,10 @@ public:
                         const transport_router::Router& router) override;
 private:
     void AddAnswerToArr(AnswerDescription* answer);
+    void AddRouteItemToArr(const WaitRouteItem& item);
+    void AddRouteItemToArr(const BusRouteItem& item);
     json::Builder builder_{};
     json::Array arr_;
+    // Reused by all the Route requests when the route cache is disabled
+    transport_router::BuildedRoute route_buffer_;
 };
\ No newline at end of file
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <atomic>
+#include <cstdlib>
+#include <functional>
+#include <list>
+#include <mutex>
+#include <optional>
+#include <unordered_map>
+#include <utility>
+
+namespace transport_router
+{
+    // Bounded map that evicts the least recently used entry. All the methods may be
+    // called concurrently: a lookup moves the entry to the front, so it takes the lock too.
+    template <typename Key, typename Value, typename Hash = std::hash<Key>>
+    class LruCache {
+        public:
+        // capacity == 0 disables the cache
+        explicit LruCache(size_t capacity = 0) : capacity_(capacity) {}
+
+        std::optional<Value> Get(const Key& key) {
+            std::lock_guard guard(mutex_);
+            auto it = index_.find(key);
+            if(it == index_.end())
+            {
+                ++miss_count_;
+                return std::nullopt;
+            }
+            ++hit_count_;
+            items_.splice(items_.begin(), items_, it->second);
+            return it->second->second;
+        }
+
+        void Put(const Key& key, Value value) {
+            std::lock_guard guard(mutex_);
+            if(capacity_ == 0)
+            {
+                return;
+            }
+            if(auto it = index_.find(key); it != index_.end())
+            {
+                it->second->second = std::move(value);
+                items_.splice(items_.begin(), items_, it->second);
+                return;
+            }
+            items_.emplace_front(key, std::move(value));
+            index_.emplace(key, items_.begin());
+            if(items_.size() > capacity_)
+            {
+                index_.erase(items_.back().first);
+                items_.pop_back();
+            }
+        }
+
+        // Drops the entries and the counters, e.g. when the data they were built from changes
+        void Clear() {
+            std::lock_guard guard(mutex_);
+            items_.clear();
+            index_.clear();
+            hit_count_ = 0;
+            miss_count_ = 0;
+        }
+
+        void SetCapacity(size_t capacity) {
+            std::lock_guard guard(mutex_);
+            capacity_ = capacity;
+            while(items_.size() > capacity_)
+            {
+                index_.erase(items_.back().first);
+                items_.pop_back();
+            }
+        }
+
+        size_t GetHitCount() const {
+            return hit_count_;
+        }
+
+        size_t GetMissCount() const {
+            return miss_count_;
+        }
+
+        private:
+        using Items = std::list<std::pair<Key, Value>>;
+
+        std::mutex mutex_;
+        size_t capacity_ = 0;
+        Items items_;
+        std::unordered_map<Key, typename Items::iterator, Hash> index_;
+        std::atomic<size_t> hit_count_ = 0;
+        std::atomic<size_t> miss_count_ = 0;
+    };
+}
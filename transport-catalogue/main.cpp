@@ -3,8 +3,16 @@
 
 #include "request_handler.h"
 #include "json_reader.h"
+#include "test_transport_catalogue.h"
 
-int main() {
+#include <string_view>
+
+int main(int argc, char* argv[]) {
+    if (argc > 1 && std::string_view(argv[1]) == "--test") {
+        RunAllTests();
+        std::cerr << "All tests passed" << std::endl;
+        return 0;
+    }
 
     Handler handler;
     InputReader json_reader;
@@ -0,0 +1,354 @@
+#include "memory_placement.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <string>
+
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+// From <linux/mman.h>, missing from older headers
+#ifndef MAP_HUGE_SHIFT
+#define MAP_HUGE_SHIFT 26
+#endif
+#ifndef MAP_HUGE_2MB
+#define MAP_HUGE_2MB (21 << MAP_HUGE_SHIFT)
+#endif
+
+namespace memory
+{
+    namespace
+    {
+        constexpr size_t HUGE_PAGE_SIZE = size_t{2} << 20;
+        // From <numaif.h>, which is not installed everywhere
+        constexpr int MPOL_BIND_MODE = 2;
+        constexpr int MPOL_INTERLEAVE_MODE = 3;
+        // Pages of a region queried for their node by the report
+        constexpr size_t MAX_SAMPLED_PAGES = 1024;
+
+        std::atomic<HugePages> huge_pages{HugePages::NONE};
+        std::atomic<NumaPolicy> numa_policy{NumaPolicy::FIRST_TOUCH};
+
+        size_t RoundUp(size_t size, size_t alignment)
+        {
+            return (size + alignment - 1) / alignment * alignment;
+        }
+
+        // Maps size bytes at an address aligned to the huge page size, so that transparent
+        // huge pages can cover the whole region
+        void* MapAligned(size_t size)
+        {
+            void* data = mmap(nullptr, size + HUGE_PAGE_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if(data == MAP_FAILED)
+            {
+                return nullptr;
+            }
+            const uintptr_t begin = reinterpret_cast<uintptr_t>(data);
+            const uintptr_t aligned_begin = RoundUp(begin, HUGE_PAGE_SIZE);
+            if(aligned_begin != begin)
+            {
+                munmap(data, aligned_begin - begin);
+            }
+            if(const size_t tail = begin + size + HUGE_PAGE_SIZE - (aligned_begin + size); tail > 0)
+            {
+                munmap(reinterpret_cast<void*>(aligned_begin + size), tail);
+            }
+            return reinterpret_cast<void*>(aligned_begin);
+        }
+
+        // Best effort: without the syscall the pages just stay with the first touch
+        void SetMemoryPolicy(void* data, size_t size, int mode, const std::vector<size_t>& nodes)
+        {
+            constexpr size_t WORD_BITS = sizeof(unsigned long) * 8;
+            std::vector<unsigned long> node_mask(GetNodeCount() / WORD_BITS + 1, 0);
+            for(const size_t node : nodes)
+            {
+                node_mask[node / WORD_BITS] |= 1UL << (node % WORD_BITS);
+            }
+            syscall(SYS_mbind, data, size, mode, node_mask.data(), node_mask.size() * WORD_BITS, 0);
+        }
+
+        // Bytes of huge pages in the mappings of the region, by /proc/self/smaps
+        size_t CountHugePageBytes(const void* data, size_t size)
+        {
+            std::ifstream smaps("/proc/self/smaps");
+            const uintptr_t begin = reinterpret_cast<uintptr_t>(data);
+            const uintptr_t end = begin + size;
+            size_t overlap = 0;
+            size_t result = 0;
+            std::string line;
+            while(std::getline(smaps, line))
+            {
+                unsigned long map_begin = 0;
+                unsigned long map_end = 0;
+                if(std::sscanf(line.c_str(), "%lx-%lx ", &map_begin, &map_end) == 2 && line.find(':') > line.find(' '))
+                {
+                    overlap = map_begin < end && begin < map_end ? std::min<uintptr_t>(end, map_end) - std::max<uintptr_t>(begin, map_begin) : 0;
+                    continue;
+                }
+                if(overlap == 0)
+                {
+                    continue;
+                }
+                std::istringstream fields(line);
+                std::string key;
+                size_t kilobytes = 0;
+                fields >> key >> kilobytes;
+                if(key == "AnonHugePages:" || key == "Private_Hugetlb:" || key == "Shared_Hugetlb:")
+                {
+                    // A mapping may be larger than the region, count at most the overlap
+                    result += std::min(kilobytes * 1024, overlap);
+                }
+            }
+            return std::min(result, size);
+        }
+
+        const char* GetName(HugePages value)
+        {
+            switch(value)
+            {
+                case HugePages::TRANSPARENT:
+                    return "transparent";
+                case HugePages::EXPLICIT:
+                    return "explicit";
+                default:
+                    return "none";
+            }
+        }
+
+        const char* GetName(NumaPolicy value)
+        {
+            switch(value)
+            {
+                case NumaPolicy::INTERLEAVE:
+                    return "interleave";
+                case NumaPolicy::REPLICATE:
+                    return "replicate";
+                default:
+                    return "first_touch";
+            }
+        }
+    }
+
+    void SetPlacementSettings(const PlacementSettings& settings)
+    {
+        huge_pages = settings.huge_pages_;
+        numa_policy = settings.numa_policy_;
+    }
+
+    PlacementSettings GetPlacementSettings()
+    {
+        return PlacementSettings{huge_pages, numa_policy};
+    }
+
+    size_t GetNodeCount()
+    {
+        static const size_t node_count = []() {
+            // A list like "0" or "0-1,3"
+            std::ifstream online("/sys/devices/system/node/online");
+            size_t max_node = 0;
+            std::string range;
+            while(std::getline(online, range, ','))
+            {
+                const size_t dash = range.find('-');
+                max_node = std::max<size_t>(max_node, std::stoul(dash == std::string::npos ? range : range.substr(dash + 1)));
+            }
+            return max_node + 1;
+        }();
+        return node_count;
+    }
+
+    size_t GetCurrentNode()
+    {
+        unsigned cpu = 0;
+        unsigned node = 0;
+        if(syscall(SYS_getcpu, &cpu, &node, nullptr) != 0)
+        {
+            return 0;
+        }
+        return node;
+    }
+
+    void* Allocate(size_t size, size_t node)
+    {
+        if(size < LARGE_ALLOCATION_SIZE)
+        {
+            return ::operator new(size);
+        }
+        const size_t mapped_size = RoundUp(size, HUGE_PAGE_SIZE);
+        const PlacementSettings settings = GetPlacementSettings();
+        void* data = nullptr;
+        if(settings.huge_pages_ == HugePages::EXPLICIT)
+        {
+            // The page size is given explicitly: with the default hugetlb size of the system (e.g. 1 GiB)
+            // the mapping would be longer than mapped_size and Deallocate would unmap it only in part
+            data = mmap(nullptr, mapped_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | MAP_HUGE_2MB, -1, 0);
+            data = data == MAP_FAILED ? nullptr : data;
+        }
+        if(!data)
+        {
+            data = MapAligned(mapped_size);
+            if(!data)
+            {
+                throw std::bad_alloc();
+            }
+            if(settings.huge_pages_ != HugePages::NONE)
+            {
+                madvise(data, mapped_size, MADV_HUGEPAGE);
+            }
+        }
+        if(GetNodeCount() > 1)
+        {
+            if(node != ANY_NODE)
+            {
+                SetMemoryPolicy(data, mapped_size, MPOL_BIND_MODE, {node});
+            }
+            else if(settings.numa_policy_ == NumaPolicy::INTERLEAVE)
+            {
+                std::vector<size_t> nodes(GetNodeCount());
+                for(size_t i = 0; i < nodes.size(); ++i)
+                {
+                    nodes[i] = i;
+                }
+                SetMemoryPolicy(data, mapped_size, MPOL_INTERLEAVE_MODE, nodes);
+            }
+        }
+        return data;
+    }
+
+    void Deallocate(void* data, size_t size) noexcept
+    {
+        if(!data)
+        {
+            return;
+        }
+        if(size < LARGE_ALLOCATION_SIZE)
+        {
+            ::operator delete(data);
+            return;
+        }
+        munmap(data, RoundUp(size, HUGE_PAGE_SIZE));
+    }
+
+    Buffer::Buffer(size_t size, size_t node)
+        : data_(Allocate(size, node))
+        , size_(size)
+    {
+    }
+
+    Buffer::Buffer(Buffer&& other) noexcept
+        : data_(other.data_)
+        , size_(other.size_)
+    {
+        other.data_ = nullptr;
+        other.size_ = 0;
+    }
+
+    Buffer& Buffer::operator=(Buffer&& other) noexcept
+    {
+        if(this != &other)
+        {
+            Deallocate(data_, size_);
+            data_ = other.data_;
+            size_ = other.size_;
+            other.data_ = nullptr;
+            other.size_ = 0;
+        }
+        return *this;
+    }
+
+    Buffer::~Buffer()
+    {
+        Deallocate(data_, size_);
+    }
+
+    void* Buffer::GetData()
+    {
+        return data_;
+    }
+
+    const void* Buffer::GetData() const
+    {
+        return data_;
+    }
+
+    size_t Buffer::GetSize() const
+    {
+        return size_;
+    }
+
+    Placement GetPlacement(const void* data, size_t size)
+    {
+        Placement placement;
+        placement.size_ = size;
+        if(!data || size == 0)
+        {
+            return placement;
+        }
+        placement.huge_page_bytes_ = CountHugePageBytes(data, size);
+
+        const size_t page_size = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+        const uintptr_t first_page = reinterpret_cast<uintptr_t>(data) / page_size * page_size;
+        const size_t page_count = (reinterpret_cast<uintptr_t>(data) + size - first_page + page_size - 1) / page_size;
+        const size_t sample_count = std::min(page_count, MAX_SAMPLED_PAGES);
+        std::vector<void*> pages(sample_count);
+        for(size_t i = 0; i < sample_count; ++i)
+        {
+            pages[i] = reinterpret_cast<void*>(first_page + i * page_count / sample_count * page_size);
+        }
+        // With no target nodes move_pages only reports where the pages are
+        std::vector<int> statuses(sample_count, -1);
+        if(syscall(SYS_move_pages, 0, sample_count, pages.data(), nullptr, statuses.data(), 0) != 0)
+        {
+            return placement;
+        }
+        placement.node_pages_.assign(GetNodeCount(), 0);
+        for(const int status : statuses)
+        {
+            if(status >= 0)
+            {
+                placement.node_pages_.resize(std::max<size_t>(placement.node_pages_.size(), status + 1), 0);
+                ++placement.node_pages_[status];
+            }
+        }
+        return placement;
+    }
+
+    void ReportPlacement(std::ostream& out, std::string_view name, const void* data, size_t size)
+    {
+        const Placement placement = GetPlacement(data, size);
+        constexpr double MEBIBYTE = 1024.0 * 1024.0;
+        out << std::fixed << std::setprecision(1) << "memory: " << name << ": " << placement.size_ / MEBIBYTE << " MiB, huge pages "
+            << placement.huge_page_bytes_ / MEBIBYTE << " MiB, nodes";
+        size_t resident_pages = 0;
+        for(const size_t pages : placement.node_pages_)
+        {
+            resident_pages += pages;
+        }
+        if(placement.node_pages_.empty())
+        {
+            out << " unknown";
+        }
+        else if(resident_pages == 0)
+        {
+            out << " none resident";
+        }
+        for(size_t node = 0; resident_pages > 0 && node < placement.node_pages_.size(); ++node)
+        {
+            out << (node == 0 ? " " : ", ") << node << ": " << 100.0 * placement.node_pages_[node] / resident_pages << '%';
+        }
+        out << std::defaultfloat << std::setprecision(6) << '\n';
+    }
+
+    void ReportSettings(std::ostream& out)
+    {
+        const PlacementSettings settings = GetPlacementSettings();
+        out << "memory: huge pages " << GetName(settings.huge_pages_) << ", numa policy " << GetName(settings.numa_policy_)
+            << ", " << GetNodeCount() << (GetNodeCount() == 1 ? " node" : " nodes") << '\n';
+    }
+}
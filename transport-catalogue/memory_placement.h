@@ -0,0 +1,115 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdlib>
+#include <limits>
+#include <new>
+#include <ostream>
+#include <string_view>
+#include <vector>
+
+namespace memory
+{
+    enum class HugePages {
+        NONE,
+        // madvise(MADV_HUGEPAGE), the kernel backs what it can with huge pages
+        TRANSPARENT,
+        // Pages from the reserved hugetlb pool; falls back to TRANSPARENT when it is empty
+        EXPLICIT
+    };
+
+    enum class NumaPolicy {
+        // Pages go to the node of the thread that touches them first
+        FIRST_TOUCH,
+        // Pages are spread round-robin over all the nodes
+        INTERLEAVE,
+        // Read-only tables get a copy bound to every node, queries read the copy of their node
+        REPLICATE
+    };
+
+    struct PlacementSettings {
+        HugePages huge_pages_ = HugePages::NONE;
+        NumaPolicy numa_policy_ = NumaPolicy::FIRST_TOUCH;
+    };
+
+    // Process-wide; applies to the allocations made after the call
+    void SetPlacementSettings(const PlacementSettings& settings);
+    PlacementSettings GetPlacementSettings();
+
+    // Number of NUMA nodes, 1 when the system has no NUMA information
+    size_t GetNodeCount();
+    // Node of the CPU the calling thread runs on
+    size_t GetCurrentNode();
+
+    // Allocations of at least this size are mapped on their own and placed by the settings,
+    // smaller ones go to operator new
+    inline constexpr size_t LARGE_ALLOCATION_SIZE = size_t{2} << 20;
+    inline constexpr size_t ANY_NODE = std::numeric_limits<size_t>::max();
+
+    // node binds a large allocation to the node instead of applying the NUMA policy
+    void* Allocate(size_t size, size_t node = ANY_NODE);
+    void Deallocate(void* data, size_t size) noexcept;
+
+    // Allocator for the big arrays of graphs and routing tables
+    template <typename T>
+    struct TableAllocator {
+        using value_type = T;
+
+        TableAllocator() = default;
+        template <typename U>
+        TableAllocator(const TableAllocator<U>&) {}
+
+        T* allocate(size_t count) {
+            if(count > std::numeric_limits<size_t>::max() / sizeof(T))
+            {
+                throw std::bad_array_new_length();
+            }
+            return static_cast<T*>(Allocate(count * sizeof(T)));
+        }
+        void deallocate(T* data, size_t count) noexcept {
+            Deallocate(data, count * sizeof(T));
+        }
+
+        template <typename U>
+        bool operator==(const TableAllocator<U>&) const {
+            return true;
+        }
+        template <typename U>
+        bool operator!=(const TableAllocator<U>&) const {
+            return false;
+        }
+    };
+
+    // Block of Allocate, e.g. a copy of a table bound to one node
+    class Buffer {
+        public:
+        Buffer() = default;
+        Buffer(size_t size, size_t node);
+        Buffer(Buffer&& other) noexcept;
+        Buffer& operator=(Buffer&& other) noexcept;
+        Buffer(const Buffer&) = delete;
+        Buffer& operator=(const Buffer&) = delete;
+        ~Buffer();
+
+        void* GetData();
+        const void* GetData() const;
+        size_t GetSize() const;
+
+        private:
+        void* data_ = nullptr;
+        size_t size_ = 0;
+    };
+
+    struct Placement {
+        size_t size_ = 0;
+        size_t huge_page_bytes_ = 0;
+        // Resident pages of a sample of the region per node; empty if the kernel does not tell
+        std::vector<size_t> node_pages_;
+    };
+
+    Placement GetPlacement(const void* data, size_t size);
+    // One line: size, huge page share and the split of the pages between the nodes
+    void ReportPlacement(std::ostream& out, std::string_view name, const void* data, size_t size);
+    // Settings and the number of nodes, printed before the regions
+    void ReportSettings(std::ostream& out);
+}
@@ -0,0 +1,573 @@
+#pragma once
+
+#include "graph.h"
+#include "parallel.h"
+#include "router.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <numeric>
+#include <optional>
+#include <queue>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+namespace graph {
+
+// Metric-independent part of the multi-level overlay: nested cells built from the graph
+// topology alone. Cells of level l + 1 are unions of cells of level l, the boundary of a
+// cell is its vertices with an edge to or from another cell of the level. Edge weights
+// play no role here, so one partition serves every metric of the same topology.
+class OverlayPartition {
+public:
+    static constexpr uint32_t NONE = std::numeric_limits<uint32_t>::max();
+
+    // max_cell_sizes bound the vertex count of the cells of each level, bottom up.
+    // Levels that would not split the graph are dropped.
+    template <typename Weight>
+    explicit OverlayPartition(const DirectedWeightedGraph<Weight>& graph,
+                              const std::vector<size_t>& max_cell_sizes = {16, 256});
+
+    // Levels are numbered from 1, level 0 is the graph itself
+    size_t GetLevelCount() const {
+        return levels_.size();
+    }
+    size_t GetCellCount(size_t level) const {
+        return levels_.at(level - 1).boundary_offsets.size() - 1;
+    }
+    uint32_t GetCell(size_t level, VertexId vertex) const {
+        return levels_[level - 1].cells[vertex];
+    }
+    size_t GetBoundarySize(size_t level, uint32_t cell) const {
+        const Level& cells = levels_[level - 1];
+        return cells.boundary_offsets[cell + 1] - cells.boundary_offsets[cell];
+    }
+    VertexId GetBoundaryVertex(size_t level, uint32_t cell, size_t index) const {
+        const Level& cells = levels_[level - 1];
+        return cells.boundary_vertices[cells.boundary_offsets[cell] + index];
+    }
+    // Position of the vertex in the boundary of its cell, NONE for inner vertices
+    uint32_t GetBoundaryIndex(size_t level, VertexId vertex) const {
+        return levels_[level - 1].boundary_indexes[vertex];
+    }
+
+    // Whether the graph has the topology the partition was built for
+    template <typename Weight>
+    bool Matches(const DirectedWeightedGraph<Weight>& graph) const {
+        return graph.GetVertexCount() == vertex_count_ && graph.GetEdgeCount() == edge_count_
+               && ComputeTopologyHash(graph) == topology_hash_;
+    }
+
+private:
+    struct Level {
+        std::vector<uint32_t> cells;
+        std::vector<size_t> boundary_offsets;
+        std::vector<VertexId> boundary_vertices;
+        std::vector<uint32_t> boundary_indexes;
+    };
+
+    // Units adjacent to each unit with the number of edges between them
+    using Adjacency = std::vector<std::vector<std::pair<uint32_t, uint32_t>>>;
+
+    template <typename Weight>
+    static Adjacency BuildAdjacency(const DirectedWeightedGraph<Weight>& graph, const std::vector<uint32_t>& vertex_units,
+                                    size_t unit_count);
+    // Greedy graph growing: every free unit, in order, starts a cell that takes in the free
+    // unit with the most edges to the cell while the size allows
+    static std::vector<uint32_t> GrowCells(const Adjacency& adjacency, const std::vector<size_t>& unit_sizes,
+                                           size_t max_cell_size, size_t& cell_count);
+    template <typename Weight>
+    void SetBoundaries(const DirectedWeightedGraph<Weight>& graph, Level& level, size_t cell_count) const;
+    template <typename Weight>
+    static uint64_t ComputeTopologyHash(const DirectedWeightedGraph<Weight>& graph);
+
+    size_t vertex_count_ = 0;
+    size_t edge_count_ = 0;
+    uint64_t topology_hash_ = 0;
+    std::vector<Level> levels_;
+};
+
+template <typename Weight>
+OverlayPartition::OverlayPartition(const DirectedWeightedGraph<Weight>& graph, const std::vector<size_t>& max_cell_sizes)
+    : vertex_count_(graph.GetVertexCount())
+    , edge_count_(graph.GetEdgeCount())
+    , topology_hash_(ComputeTopologyHash(graph))
+{
+    // Units of the first level are the vertices, of the next ones the cells below
+    std::vector<uint32_t> vertex_units(vertex_count_);
+    std::iota(vertex_units.begin(), vertex_units.end(), 0);
+    std::vector<size_t> unit_sizes(vertex_count_, 1);
+    for (const size_t max_cell_size : max_cell_sizes) {
+        std::vector<uint32_t> cells = vertex_units;
+        std::vector<size_t> cell_sizes = unit_sizes;
+        // Growth over the cells of the previous pass merges the small cells it left behind
+        while (true) {
+            size_t cell_count = 0;
+            const std::vector<uint32_t> merged_cells
+                = GrowCells(BuildAdjacency(graph, cells, cell_sizes.size()), cell_sizes, max_cell_size, cell_count);
+            if (cell_count == cell_sizes.size()) {
+                break;
+            }
+            std::vector<size_t> merged_sizes(cell_count, 0);
+            for (uint32_t cell = 0; cell < cell_sizes.size(); ++cell) {
+                merged_sizes[merged_cells[cell]] += cell_sizes[cell];
+            }
+            for (uint32_t& cell : cells) {
+                cell = merged_cells[cell];
+            }
+            cell_sizes = std::move(merged_sizes);
+        }
+        if (cell_sizes.size() == unit_sizes.size()) {
+            continue;
+        }
+        if (cell_sizes.size() <= 1) {
+            break;
+        }
+        Level level;
+        level.cells = std::move(cells);
+        SetBoundaries(graph, level, cell_sizes.size());
+        vertex_units = level.cells;
+        unit_sizes = std::move(cell_sizes);
+        levels_.push_back(std::move(level));
+    }
+}
+
+template <typename Weight>
+OverlayPartition::Adjacency OverlayPartition::BuildAdjacency(const DirectedWeightedGraph<Weight>& graph,
+                                                             const std::vector<uint32_t>& vertex_units, size_t unit_count) {
+    Adjacency adjacency(unit_count);
+    for (EdgeId edge_id = 0; edge_id < graph.GetEdgeCount(); ++edge_id) {
+        const auto& edge = graph.GetEdge(edge_id);
+        const uint32_t from_unit = vertex_units[edge.from];
+        const uint32_t to_unit = vertex_units[edge.to];
+        if (from_unit != to_unit) {
+            adjacency[from_unit].push_back({to_unit, 1});
+            adjacency[to_unit].push_back({from_unit, 1});
+        }
+    }
+    for (auto& units : adjacency) {
+        std::sort(units.begin(), units.end());
+        size_t size = 0;
+        for (size_t i = 0; i < units.size(); ++i) {
+            if (size > 0 && units[size - 1].first == units[i].first) {
+                ++units[size - 1].second;
+            } else {
+                units[size++] = units[i];
+            }
+        }
+        units.resize(size);
+    }
+    return adjacency;
+}
+
+inline std::vector<uint32_t> OverlayPartition::GrowCells(const Adjacency& adjacency, const std::vector<size_t>& unit_sizes,
+                                                         size_t max_cell_size, size_t& cell_count) {
+    const size_t unit_count = unit_sizes.size();
+    std::vector<uint32_t> unit_cells(unit_count, NONE);
+    // Edges from a free unit to the growing cell, valid while its stamp is the cell
+    std::vector<uint32_t> connections(unit_count, 0);
+    std::vector<uint32_t> connection_stamps(unit_count, NONE);
+    std::priority_queue<std::pair<uint32_t, uint32_t>> candidates;
+    cell_count = 0;
+    for (uint32_t seed = 0; seed < unit_count; ++seed) {
+        if (unit_cells[seed] != NONE) {
+            continue;
+        }
+        const uint32_t cell = static_cast<uint32_t>(cell_count++);
+        size_t cell_size = 0;
+        auto take = [&](uint32_t unit) {
+            unit_cells[unit] = cell;
+            cell_size += unit_sizes[unit];
+            for (const auto& [next, edge_count] : adjacency[unit]) {
+                if (unit_cells[next] != NONE) {
+                    continue;
+                }
+                if (connection_stamps[next] != cell) {
+                    connection_stamps[next] = cell;
+                    connections[next] = 0;
+                }
+                connections[next] += edge_count;
+                candidates.push({connections[next], next});
+            }
+        };
+        take(seed);
+        while (!candidates.empty()) {
+            const auto [connection, unit] = candidates.top();
+            candidates.pop();
+            if (unit_cells[unit] == NONE && connection == connections[unit] && cell_size + unit_sizes[unit] <= max_cell_size) {
+                take(unit);
+            }
+        }
+    }
+    return unit_cells;
+}
+
+template <typename Weight>
+void OverlayPartition::SetBoundaries(const DirectedWeightedGraph<Weight>& graph, Level& level, size_t cell_count) const {
+    std::vector<bool> is_boundary(vertex_count_, false);
+    for (EdgeId edge_id = 0; edge_id < edge_count_; ++edge_id) {
+        const auto& edge = graph.GetEdge(edge_id);
+        if (level.cells[edge.from] != level.cells[edge.to]) {
+            is_boundary[edge.from] = true;
+            is_boundary[edge.to] = true;
+        }
+    }
+    level.boundary_offsets.assign(cell_count + 1, 0);
+    for (VertexId vertex = 0; vertex < vertex_count_; ++vertex) {
+        if (is_boundary[vertex]) {
+            ++level.boundary_offsets[level.cells[vertex] + 1];
+        }
+    }
+    std::partial_sum(level.boundary_offsets.begin(), level.boundary_offsets.end(), level.boundary_offsets.begin());
+    level.boundary_vertices.resize(level.boundary_offsets.back());
+    level.boundary_indexes.assign(vertex_count_, NONE);
+    std::vector<size_t> positions(level.boundary_offsets.begin(), level.boundary_offsets.end() - 1);
+    for (VertexId vertex = 0; vertex < vertex_count_; ++vertex) {
+        if (is_boundary[vertex]) {
+            const uint32_t cell = level.cells[vertex];
+            level.boundary_indexes[vertex] = static_cast<uint32_t>(positions[cell] - level.boundary_offsets[cell]);
+            level.boundary_vertices[positions[cell]++] = vertex;
+        }
+    }
+}
+
+template <typename Weight>
+uint64_t OverlayPartition::ComputeTopologyHash(const DirectedWeightedGraph<Weight>& graph) {
+    // FNV-1a over the ends of the edges
+    uint64_t hash = 14695981039346656037ULL;
+    for (EdgeId edge_id = 0; edge_id < graph.GetEdgeCount(); ++edge_id) {
+        const auto& edge = graph.GetEdge(edge_id);
+        for (const uint64_t value : {static_cast<uint64_t>(edge.from), static_cast<uint64_t>(edge.to)}) {
+            hash = (hash ^ value) * 1099511628211ULL;
+        }
+    }
+    return hash;
+}
+
+// Customizable route planning over an OverlayPartition. Customization computes, level by
+// level, the route weights between the boundary vertices of every cell (a clique per cell)
+// by searches inside the cell over the level below. A query is a Dijkstra that takes the
+// original edges only in the lowest cells of the source and the target and, elsewhere,
+// the cliques of the highest level whose cell holds neither of them.
+template <typename Weight>
+class OverlayRouter : public RouterInterface<Weight> {
+private:
+    using Graph = DirectedWeightedGraph<Weight>;
+
+public:
+    using typename RouterInterface<Weight>::RouteInfo;
+
+    OverlayRouter(const Graph& graph, std::shared_ptr<const OverlayPartition> partition);
+
+    std::optional<RouteInfo> BuildRoute(VertexId from, VertexId to) const override;
+
+    // Recomputes the cliques for the current edge weights; the partition is kept, so this
+    // is all a change of the weights alone requires
+    void Customize();
+    const OverlayPartition& GetPartition() const;
+
+private:
+    static constexpr EdgeId NO_EDGE = std::numeric_limits<EdgeId>::max();
+    static constexpr VertexId NO_VERTEX = std::numeric_limits<VertexId>::max();
+    static constexpr uint32_t NO_CELL = OverlayPartition::NONE;
+    static constexpr Weight UNREACHABLE = std::numeric_limits<Weight>::has_infinity
+                                              ? std::numeric_limits<Weight>::infinity()
+                                              : std::numeric_limits<Weight>::max();
+
+    // The arc a vertex was reached by: an original edge, or a clique arc of the level
+    // when edge is NO_EDGE
+    struct Parent {
+        VertexId vertex = NO_VERTEX;
+        EdgeId edge = NO_EDGE;
+        uint32_t level = 0;
+    };
+
+    // Distances of a search, reset in O(1) between searches by bumping the stamp
+    struct SearchSpace {
+        explicit SearchSpace(size_t vertex_count)
+            : weights(vertex_count)
+            , parents(vertex_count)
+            , stamps(vertex_count, 0) {
+        }
+        bool IsReached(VertexId vertex) const {
+            return stamps[vertex] == stamp;
+        }
+
+        std::vector<Weight> weights;
+        std::vector<Parent> parents;
+        std::vector<uint32_t> stamps;
+        uint32_t stamp = 0;
+    };
+
+    using QueueItem = std::pair<Weight, VertexId>;
+    using Queue = std::priority_queue<QueueItem, std::vector<QueueItem>, std::greater<QueueItem>>;
+
+    // Calls func(to, weight, edge) for the arcs of the vertex in the overlay of the level:
+    // all its edges on level 0; otherwise the clique arcs of its cell, with NO_EDGE, and
+    // the edges that leave the cell
+    template <typename Func>
+    void ForEachArc(VertexId vertex, size_t level, Func&& func) const;
+    // Dijkstra over the overlay of the level that does not leave the cell of level + 1
+    // (NO_CELL lets it go anywhere) and stops at target unless it is NO_VERTEX
+    void Search(VertexId source, VertexId target, size_t level, uint32_t cell, SearchSpace& space) const;
+    void CustomizeCell(size_t level, uint32_t cell, SearchSpace& space);
+    // Highest level whose cell of the vertex holds neither from nor to, 0 if there is none
+    size_t GetQueryLevel(VertexId vertex, VertexId from, VertexId to) const;
+    // Replaces a clique arc by the edges of its route, searching inside its cell level by level
+    void UnpackArc(VertexId from, VertexId to, size_t level, std::vector<EdgeId>& edges) const;
+    // Arcs of the found route to target, in order from the source
+    static std::vector<std::pair<VertexId, Parent>> CollectArcs(VertexId target, const SearchSpace& space);
+
+    static void NewSearch(SearchSpace& space);
+    std::unique_ptr<SearchSpace> AcquireSearchSpace() const;
+    void ReleaseSearchSpace(std::unique_ptr<SearchSpace> space) const;
+
+    static constexpr Weight ZERO_WEIGHT{};
+    const Graph& graph_;
+    std::shared_ptr<const OverlayPartition> partition_;
+    // Clique of cell c of level l: row-major boundary x boundary weights from
+    // clique_weights_[l - 1][clique_offsets_[l - 1][c]] on
+    std::vector<std::vector<size_t>> clique_offsets_;
+    std::vector<std::vector<Weight>> clique_weights_;
+
+    mutable std::mutex search_spaces_mutex_;
+    mutable std::vector<std::unique_ptr<SearchSpace>> search_spaces_;
+};
+
+template <typename Weight>
+OverlayRouter<Weight>::OverlayRouter(const Graph& graph, std::shared_ptr<const OverlayPartition> partition)
+    : graph_(graph)
+    , partition_(std::move(partition))
+{
+    if (!partition_->Matches(graph)) {
+        throw std::invalid_argument("The partition was built for another graph");
+    }
+    for (EdgeId edge_id = 0; edge_id < graph.GetEdgeCount(); ++edge_id) {
+        if (graph.GetEdge(edge_id).weight < ZERO_WEIGHT) {
+            throw std::domain_error("Edges' weights should be non-negative");
+        }
+    }
+    const size_t level_count = partition_->GetLevelCount();
+    clique_offsets_.resize(level_count);
+    clique_weights_.resize(level_count);
+    for (size_t level = 1; level <= level_count; ++level) {
+        auto& offsets = clique_offsets_[level - 1];
+        offsets.assign(partition_->GetCellCount(level) + 1, 0);
+        for (uint32_t cell = 0; cell < partition_->GetCellCount(level); ++cell) {
+            const size_t boundary_size = partition_->GetBoundarySize(level, cell);
+            offsets[cell + 1] = offsets[cell] + boundary_size * boundary_size;
+        }
+        clique_weights_[level - 1].assign(offsets.back(), UNREACHABLE);
+    }
+    Customize();
+}
+
+template <typename Weight>
+void OverlayRouter<Weight>::Customize() {
+    // Cells of a level only read the cliques of the level below, so they run in parallel
+    for (size_t level = 1; level <= partition_->GetLevelCount(); ++level) {
+        parallel::ForEachIndex(partition_->GetCellCount(level), [this, level](size_t cell) {
+            auto space = AcquireSearchSpace();
+            CustomizeCell(level, static_cast<uint32_t>(cell), *space);
+            ReleaseSearchSpace(std::move(space));
+        });
+    }
+}
+
+template <typename Weight>
+const OverlayPartition& OverlayRouter<Weight>::GetPartition() const {
+    return *partition_;
+}
+
+template <typename Weight>
+void OverlayRouter<Weight>::CustomizeCell(size_t level, uint32_t cell, SearchSpace& space) {
+    const size_t boundary_size = partition_->GetBoundarySize(level, cell);
+    Weight* const clique = clique_weights_[level - 1].data() + clique_offsets_[level - 1][cell];
+    for (size_t i = 0; i < boundary_size; ++i) {
+        Search(partition_->GetBoundaryVertex(level, cell, i), NO_VERTEX, level - 1, cell, space);
+        for (size_t j = 0; j < boundary_size; ++j) {
+            const VertexId vertex = partition_->GetBoundaryVertex(level, cell, j);
+            clique[i * boundary_size + j] = space.IsReached(vertex) ? space.weights[vertex] : UNREACHABLE;
+        }
+    }
+}
+
+template <typename Weight>
+template <typename Func>
+void OverlayRouter<Weight>::ForEachArc(VertexId vertex, size_t level, Func&& func) const {
+    if (level == 0) {
+        graph_.ForEachIncidentEdge(vertex, [&func](EdgeId edge_id, VertexId to, Weight weight) {
+            func(to, weight, edge_id);
+        });
+        return;
+    }
+    const uint32_t cell = partition_->GetCell(level, vertex);
+    const uint32_t index = partition_->GetBoundaryIndex(level, vertex);
+    if (index != OverlayPartition::NONE) {
+        const size_t boundary_size = partition_->GetBoundarySize(level, cell);
+        const Weight* const row = clique_weights_[level - 1].data() + clique_offsets_[level - 1][cell] + index * boundary_size;
+        for (size_t j = 0; j < boundary_size; ++j) {
+            if (j != index && row[j] != UNREACHABLE) {
+                func(partition_->GetBoundaryVertex(level, cell, j), row[j], NO_EDGE);
+            }
+        }
+    }
+    graph_.ForEachIncidentEdge(vertex, [&](EdgeId edge_id, VertexId to, Weight weight) {
+        if (partition_->GetCell(level, to) != cell) {
+            func(to, weight, edge_id);
+        }
+    });
+}
+
+template <typename Weight>
+void OverlayRouter<Weight>::Search(VertexId source, VertexId target, size_t level, uint32_t cell, SearchSpace& space) const {
+    NewSearch(space);
+    Queue queue;
+    space.stamps[source] = space.stamp;
+    space.weights[source] = ZERO_WEIGHT;
+    space.parents[source] = Parent{};
+    queue.push({ZERO_WEIGHT, source});
+    while (!queue.empty()) {
+        const auto [weight, vertex] = queue.top();
+        queue.pop();
+        if (space.weights[vertex] < weight) {
+            continue;
+        }
+        if (vertex == target) {
+            return;
+        }
+        ForEachArc(vertex, level, [&, weight = weight, vertex = vertex](VertexId to, Weight arc_weight, EdgeId edge) {
+            if (cell != NO_CELL && partition_->GetCell(level + 1, to) != cell) {
+                return;
+            }
+            const Weight candidate_weight = weight + arc_weight;
+            if (!space.IsReached(to) || candidate_weight < space.weights[to]) {
+                space.stamps[to] = space.stamp;
+                space.weights[to] = candidate_weight;
+                space.parents[to] = Parent{vertex, edge, static_cast<uint32_t>(level)};
+                queue.push({candidate_weight, to});
+            }
+        });
+    }
+}
+
+template <typename Weight>
+size_t OverlayRouter<Weight>::GetQueryLevel(VertexId vertex, VertexId from, VertexId to) const {
+    for (size_t level = partition_->GetLevelCount(); level > 0; --level) {
+        const uint32_t cell = partition_->GetCell(level, vertex);
+        if (cell != partition_->GetCell(level, from) && cell != partition_->GetCell(level, to)) {
+            return level;
+        }
+    }
+    return 0;
+}
+
+template <typename Weight>
+std::optional<typename OverlayRouter<Weight>::RouteInfo> OverlayRouter<Weight>::BuildRoute(VertexId from, VertexId to) const {
+    if (from >= graph_.GetVertexCount() || to >= graph_.GetVertexCount()) {
+        throw std::out_of_range("Vertex id is out of range");
+    }
+    auto space = AcquireSearchSpace();
+    NewSearch(*space);
+    Queue queue;
+    space->stamps[from] = space->stamp;
+    space->weights[from] = ZERO_WEIGHT;
+    space->parents[from] = Parent{};
+    queue.push({ZERO_WEIGHT, from});
+    while (!queue.empty()) {
+        const auto [weight, vertex] = queue.top();
+        queue.pop();
+        if (space->weights[vertex] < weight) {
+            continue;
+        }
+        if (vertex == to) {
+            break;
+        }
+        const size_t level = GetQueryLevel(vertex, from, to);
+        ForEachArc(vertex, level, [&, weight = weight, vertex = vertex](VertexId next, Weight arc_weight, EdgeId edge) {
+            const Weight candidate_weight = weight + arc_weight;
+            if (!space->IsReached(next) || candidate_weight < space->weights[next]) {
+                space->stamps[next] = space->stamp;
+                space->weights[next] = candidate_weight;
+                space->parents[next] = Parent{vertex, edge, static_cast<uint32_t>(level)};
+                queue.push({candidate_weight, next});
+            }
+        });
+    }
+
+    std::optional<RouteInfo> result;
+    if (space->IsReached(to)) {
+        const auto arcs = CollectArcs(to, *space);
+        result = RouteInfo{space->weights[to], {}};
+        ReleaseSearchSpace(std::move(space));
+        for (const auto& [arc_to, parent] : arcs) {
+            if (parent.edge != NO_EDGE) {
+                result->edges.push_back(parent.edge);
+            } else {
+                UnpackArc(parent.vertex, arc_to, parent.level, result->edges);
+            }
+        }
+        return result;
+    }
+    ReleaseSearchSpace(std::move(space));
+    return result;
+}
+
+template <typename Weight>
+std::vector<std::pair<VertexId, typename OverlayRouter<Weight>::Parent>>
+OverlayRouter<Weight>::CollectArcs(VertexId target, const SearchSpace& space) {
+    std::vector<std::pair<VertexId, Parent>> arcs;
+    for (VertexId vertex = target; space.parents[vertex].vertex != NO_VERTEX; vertex = space.parents[vertex].vertex) {
+        arcs.push_back({vertex, space.parents[vertex]});
+    }
+    std::reverse(arcs.begin(), arcs.end());
+    return arcs;
+}
+
+template <typename Weight>
+void OverlayRouter<Weight>::UnpackArc(VertexId from, VertexId to, size_t level, std::vector<EdgeId>& edges) const {
+    auto space = AcquireSearchSpace();
+    Search(from, to, level - 1, partition_->GetCell(level, from), *space);
+    const auto arcs = CollectArcs(to, *space);
+    ReleaseSearchSpace(std::move(space));
+    for (const auto& [arc_to, parent] : arcs) {
+        if (parent.edge != NO_EDGE) {
+            edges.push_back(parent.edge);
+        } else {
+            UnpackArc(parent.vertex, arc_to, parent.level, edges);
+        }
+    }
+}
+
+template <typename Weight>
+void OverlayRouter<Weight>::NewSearch(SearchSpace& space) {
+    if (++space.stamp == 0) {
+        std::fill(space.stamps.begin(), space.stamps.end(), 0);
+        space.stamp = 1;
+    }
+}
+
+template <typename Weight>
+std::unique_ptr<typename OverlayRouter<Weight>::SearchSpace> OverlayRouter<Weight>::AcquireSearchSpace() const {
+    {
+        std::lock_guard guard(search_spaces_mutex_);
+        if (!search_spaces_.empty()) {
+            auto space = std::move(search_spaces_.back());
+            search_spaces_.pop_back();
+            return space;
+        }
+    }
+    return std::make_unique<SearchSpace>(graph_.GetVertexCount());
+}
+
+template <typename Weight>
+void OverlayRouter<Weight>::ReleaseSearchSpace(std::unique_ptr<SearchSpace> space) const {
+    std::lock_guard guard(search_spaces_mutex_);
+    search_spaces_.push_back(std::move(space));
+}
+
+}  // namespace graph
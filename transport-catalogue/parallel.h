@@ -0,0 +1,81 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace parallel {
+
+inline size_t GetThreadCount() {
+    return std::max<size_t>(1, std::thread::hardware_concurrency());
+}
+
+// Calls func(state, index) for every index in [0, count) on all cores. Every thread makes
+// its own state with make_state() before taking indices, so scratch memory kept there is
+// allocated once per thread and not once per index. Indices are handed out one by one
+// from a shared counter, so uneven tasks still keep every thread busy. The first exception
+// thrown by make_state or func stops handing out indices and is rethrown to the caller
+// once every thread has finished.
+template <typename MakeState, typename Func>
+void ForEachIndexWithState(size_t count, const MakeState& make_state, const Func& func) {
+    const size_t thread_count = std::min(GetThreadCount(), count);
+    if (thread_count <= 1) {
+        if (count != 0) {
+            auto state = make_state();
+            for (size_t index = 0; index < count; ++index) {
+                func(state, index);
+            }
+        }
+        return;
+    }
+
+    std::atomic<size_t> next_index{0};
+    std::mutex error_mutex;
+    std::exception_ptr error;
+    auto worker = [&]() {
+        try {
+            auto state = make_state();
+            for (size_t index = next_index++; index < count; index = next_index++) {
+                func(state, index);
+            }
+        } catch (...) {
+            next_index = count;
+            std::lock_guard guard(error_mutex);
+            if (!error) {
+                error = std::current_exception();
+            }
+        }
+    };
+    std::vector<std::thread> threads;
+    try {
+        threads.reserve(thread_count - 1);
+        for (size_t i = 0; i + 1 < thread_count; ++i) {
+            threads.emplace_back(worker);
+        }
+    } catch (const std::exception&) {
+        // Out of threads or memory for them: the started threads and the calling one
+        // still take all the indices
+    }
+    worker();
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
+
+// Calls func(index) for every index in [0, count) on all cores
+template <typename Func>
+void ForEachIndex(size_t count, const Func& func) {
+    struct NoState {};
+    ForEachIndexWithState(count, [] { return NoState{}; }, [&func](NoState&, size_t index) {
+        func(index);
+    });
+}
+
+}  // namespace parallel
@@ -0,0 +1,217 @@
+#include "raptor_router.h"
+
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+#include <string>
+
+namespace transport_router
+{
+    namespace
+    {
+        constexpr double UNREACHED = std::numeric_limits<double>::infinity();
+    }
+
+    RaptorRouter::RaptorRouter(const transport_catalogue::TransportCatalogue& transp_catalogue, const RouteSettings& route_settings)
+        : bus_wait_time_(route_settings.bus_wait_time_)
+        , bus_velocity_(route_settings.bus_velocity_)
+    {
+        const auto& stops = transp_catalogue.GetAllStops();
+        const auto& buses = transp_catalogue.GetAllRoutes();
+        bus_offsets_.reserve(buses.size() + 1);
+        bus_offsets_.push_back(0);
+        std::vector<uint32_t> stop_route_counts(stops.size(), 0);
+        for(const auto& bus : buses)
+        {
+            for(size_t i = 0; i < bus.stop_ids_.size(); ++i)
+            {
+                const StopId stop = bus.stop_ids_[i];
+                bus_stops_.push_back(stop);
+                bus_distances_.push_back(bus.cumulative_distances_[i]);
+                ++stop_route_counts[stop];
+            }
+            bus_offsets_.push_back(static_cast<uint32_t>(bus_stops_.size()));
+        }
+
+        stop_offsets_.assign(stops.size() + 1, 0);
+        for(size_t stop = 0; stop < stops.size(); ++stop)
+        {
+            stop_offsets_[stop + 1] = stop_offsets_[stop] + stop_route_counts[stop];
+        }
+        stop_routes_.resize(bus_stops_.size());
+        std::vector<uint32_t> fill_positions(stop_offsets_.begin(), stop_offsets_.end() - 1);
+        for(uint32_t bus_index = 0; bus_index + 1 < bus_offsets_.size(); ++bus_index)
+        {
+            for(uint32_t i = bus_offsets_[bus_index]; i < bus_offsets_[bus_index + 1]; ++i)
+            {
+                stop_routes_[fill_positions[bus_stops_[i]]++] = StopRoute{bus_index, i - bus_offsets_[bus_index]};
+            }
+        }
+    }
+
+    StopId RaptorRouter::GetStopAt(BusId bus_index, uint32_t position) const
+    {
+        return bus_stops_[bus_offsets_[bus_index] + position];
+    }
+
+    std::optional<RaptorRouter::Journey> RaptorRouter::BuildRoute(StopId from_stop, StopId to_stop) const
+    {
+        const size_t stop_count = stop_offsets_.size() - 1;
+        if(from_stop >= stop_count || to_stop >= stop_count)
+        {
+            throw std::out_of_range("Stop index is out of range");
+        }
+        std::vector<std::vector<Label>> rounds;
+        std::vector<double> best_times;
+        RunRounds(from_stop, to_stop, UNREACHED, rounds, best_times);
+
+        if(best_times[to_stop] == UNREACHED)
+        {
+            return std::nullopt;
+        }
+        Journey journey;
+        journey.total_time = best_times[to_stop];
+        const Label* label = &rounds.back()[to_stop];
+        while(label->leg.bus_index != NO_BUS)
+        {
+            journey.legs.push_back(label->leg);
+            const uint32_t board_stop = GetStopAt(label->leg.bus_index, label->leg.board_position);
+            label = &rounds[label->round - 1][board_stop];
+        }
+        std::reverse(journey.legs.begin(), journey.legs.end());
+        return journey;
+    }
+
+    std::vector<std::optional<double>> RaptorRouter::BuildTimes(StopId from_stop, const std::vector<StopId>& to_stops) const
+    {
+        const size_t stop_count = stop_offsets_.size() - 1;
+        if(from_stop >= stop_count)
+        {
+            throw std::out_of_range("Stop index is out of range");
+        }
+        std::vector<std::vector<Label>> rounds;
+        std::vector<double> best_times;
+        RunRounds(from_stop, NO_STOP, UNREACHED, rounds, best_times);
+
+        std::vector<std::optional<double>> times;
+        times.reserve(to_stops.size());
+        for(const uint32_t to_stop : to_stops)
+        {
+            times.push_back(best_times.at(to_stop) == UNREACHED ? std::nullopt : std::optional<double>(best_times[to_stop]));
+        }
+        return times;
+    }
+
+    void RaptorRouter::ForEachReachable(StopId from_stop, double max_time, const std::function<void(StopId, double)>& func) const
+    {
+        const size_t stop_count = stop_offsets_.size() - 1;
+        if(from_stop >= stop_count)
+        {
+            throw std::out_of_range("Stop index is out of range");
+        }
+        std::vector<std::vector<Label>> rounds;
+        std::vector<double> best_times;
+        RunRounds(from_stop, NO_STOP, max_time, rounds, best_times);
+        for(StopId stop = 0; stop < stop_count; ++stop)
+        {
+            if(best_times[stop] != UNREACHED)
+            {
+                func(stop, best_times[stop]);
+            }
+        }
+    }
+
+    void RaptorRouter::RunRounds(uint32_t from_stop, uint32_t to_stop, double max_time, std::vector<std::vector<Label>>& rounds,
+                                 std::vector<double>& best_times) const
+    {
+        const size_t stop_count = stop_offsets_.size() - 1;
+        const size_t bus_count = bus_offsets_.size() - 1;
+
+        Label unreached;
+        unreached.time = UNREACHED;
+        unreached.leg.bus_index = NO_BUS;
+        rounds.assign(1, std::vector<Label>(stop_count, unreached));
+        rounds[0][from_stop].time = 0.0;
+        best_times.assign(stop_count, UNREACHED);
+        best_times[from_stop] = 0.0;
+
+        std::vector<uint32_t> improved_stops{from_stop};
+        std::vector<bool> is_improved(stop_count, false);
+        std::vector<uint32_t> first_positions(bus_count, NO_BUS);
+        std::vector<uint32_t> touched_buses;
+        while(!improved_stops.empty())
+        {
+            for(const uint32_t stop : improved_stops)
+            {
+                is_improved[stop] = false;
+                for(uint32_t i = stop_offsets_[stop]; i < stop_offsets_[stop + 1]; ++i)
+                {
+                    const StopRoute& stop_route = stop_routes_[i];
+                    if(first_positions[stop_route.bus_index] == NO_BUS)
+                    {
+                        touched_buses.push_back(stop_route.bus_index);
+                    }
+                    first_positions[stop_route.bus_index] = std::min(first_positions[stop_route.bus_index], stop_route.position);
+                }
+            }
+            improved_stops.clear();
+
+            std::vector<Label> current_round = rounds.back();
+            const uint32_t round = static_cast<uint32_t>(rounds.size());
+            for(const uint32_t bus_index : touched_buses)
+            {
+                ScanBus(bus_index, first_positions[bus_index], round, rounds.back(), current_round, best_times, to_stop,
+                        max_time, improved_stops, is_improved);
+                first_positions[bus_index] = NO_BUS;
+            }
+            touched_buses.clear();
+            rounds.push_back(std::move(current_round));
+        }
+    }
+
+    void RaptorRouter::ScanBus(uint32_t bus_index, uint32_t first_position, uint32_t round, const std::vector<Label>& previous_round,
+                               std::vector<Label>& current_round, std::vector<double>& best_times, uint32_t to_stop,
+                               double max_time, std::vector<uint32_t>& improved_stops, std::vector<bool>& is_improved) const
+    {
+        const uint32_t begin = bus_offsets_[bus_index];
+        const uint32_t size = bus_offsets_[bus_index + 1] - begin;
+        bool is_boarded = false;
+        uint32_t board_position = 0;
+        double board_time = 0.0;
+        double ride_time = 0.0;
+        for(uint32_t position = first_position; position < size; ++position)
+        {
+            const uint32_t stop = bus_stops_[begin + position];
+            if(is_boarded)
+            {
+                // Same difference of the cumulative distances as for the span edges of the graph
+                const double distance = bus_distances_[begin + position] - bus_distances_[begin + board_position];
+                ride_time = (distance / (1000 * bus_velocity_)) * 60; // 1000 - meters to km, 60 hours to minutes
+                const double arrival_time = board_time + ride_time;
+                if(arrival_time < best_times[stop] && arrival_time <= max_time
+                    && (to_stop == NO_STOP || arrival_time < best_times[to_stop]))
+                {
+                    best_times[stop] = arrival_time;
+                    current_round[stop] = Label{arrival_time, round, Leg{bus_index, board_position, position, ride_time}};
+                    if(!is_improved[stop])
+                    {
+                        is_improved[stop] = true;
+                        improved_stops.push_back(stop);
+                    }
+                }
+            }
+            // Boarding here is better if it beats staying on the bus
+            if(previous_round[stop].time != UNREACHED)
+            {
+                const double candidate_board_time = previous_round[stop].time + bus_wait_time_;
+                if(!is_boarded || candidate_board_time < board_time + ride_time)
+                {
+                    is_boarded = true;
+                    board_position = position;
+                    board_time = candidate_board_time;
+                    ride_time = 0.0;
+                }
+            }
+        }
+    }
+}
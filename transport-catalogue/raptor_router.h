@@ -0,0 +1,81 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <vector>
+
+#include "transport_catalogue.h"
+#include "domain.h"
+
+namespace transport_router
+{
+    // Round-based router over the bus route arrays (RAPTOR). Round k finds the best
+    // routes with k boardings by scanning, stop by stop, every bus that serves a stop
+    // improved in round k - 1. Nothing quadratic in the route length is built: buses
+    // are kept as contiguous stop arrays and stops as lists of (bus, position).
+    class RaptorRouter {
+        public:
+        // One ride: wait at the stop at board_position, then go span_count stops
+        struct Leg {
+            uint32_t bus_index = 0;
+            uint32_t board_position = 0;
+            uint32_t alight_position = 0;
+            double time = 0.0;
+        };
+
+        struct Journey {
+            double total_time = 0.0;
+            std::vector<Leg> legs;
+        };
+
+        RaptorRouter(const transport_catalogue::TransportCatalogue& transp_catalogue, const RouteSettings& route_settings);
+
+        // Stops and buses are referred to by their catalogue ids
+        std::optional<Journey> BuildRoute(StopId from_stop, StopId to_stop) const;
+        // Total times from one stop to each of the targets, all from the same rounds
+        std::vector<std::optional<double>> BuildTimes(StopId from_stop, const std::vector<StopId>& to_stops) const;
+        // Calls func(stop, time) for every stop reachable within max_time; rides that arrive
+        // later are not scanned further
+        void ForEachReachable(StopId from_stop, double max_time, const std::function<void(StopId, double)>& func) const;
+        StopId GetStopAt(BusId bus_index, uint32_t position) const;
+
+        private:
+        struct StopRoute {
+            uint32_t bus_index;
+            uint32_t position;
+        };
+
+        struct Label {
+            double time = 0.0;
+            // Round the label was set in; the ride started from the label of the previous round
+            uint32_t round = 0;
+            // Leg of the last ride; bus_index == NO_BUS for the start stop
+            Leg leg;
+        };
+
+        static constexpr uint32_t NO_BUS = UINT32_MAX;
+        static constexpr uint32_t NO_STOP = UINT32_MAX;
+
+        // Runs the rounds until no stop improves; labels later than max_time or that can not
+        // beat the best time at to_stop are pruned, the latter unless it is NO_STOP
+        void RunRounds(uint32_t from_stop, uint32_t to_stop, double max_time, std::vector<std::vector<Label>>& rounds,
+                       std::vector<double>& best_times) const;
+
+        // Rides the bus from the earliest improved position and relaxes the stops after it
+        void ScanBus(uint32_t bus_index, uint32_t first_position, uint32_t round, const std::vector<Label>& previous_round,
+                     std::vector<Label>& current_round, std::vector<double>& best_times, uint32_t to_stop, double max_time,
+                     std::vector<uint32_t>& improved_stops, std::vector<bool>& is_improved) const;
+
+        double bus_wait_time_ = 0.0;
+        double bus_velocity_ = 0.0;
+        // Stops of bus b are bus_stops_[bus_offsets_[b] .. bus_offsets_[b + 1]), bus_distances_
+        // holds Bus::cumulative_distances_ for them
+        std::vector<uint32_t> bus_offsets_;
+        std::vector<uint32_t> bus_stops_;
+        std::vector<double> bus_distances_;
+        // Buses through stop s are stop_routes_[stop_offsets_[s] .. stop_offsets_[s + 1])
+        std::vector<uint32_t> stop_offsets_;
+        std::vector<StopRoute> stop_routes_;
+    };
+}
@@ -1,13 +1,20 @@
 #pragma once
 
 #include "graph.h"
+#include "memory_placement.h"
+#include "parallel.h"
 
 #include <algorithm>
+#include <atomic>
 #include <cassert>
 #include <cstdint>
+#include <cstring>
+#include <functional>
 #include <iterator>
+#include <limits>
 #include <optional>
 #include <stdexcept>
+#include <type_traits>
 #include <unordered_map>
 #include <utility>
 #include <vector>
@@ -15,103 +22,679 @@
 namespace graph {
 
 template <typename Weight>
-class Router {
-private:
-    using Graph = DirectedWeightedGraph<Weight>;
-
+class RouterInterface {
 public:
-    explicit Router(const Graph& graph);
-
     struct RouteInfo {
         Weight weight;
         std::vector<EdgeId> edges;
     };
+    using ReachableCallback = std::function<void(VertexId vertex, Weight weight)>;
+
+    virtual std::optional<RouteInfo> BuildRoute(VertexId from, VertexId to) const = 0;
+    // Same as BuildRoute, but fills the caller's route, so its edges buffer is reused
+    // between queries; returns false if there is no route
+    virtual bool BuildRouteInto(VertexId from, VertexId to, RouteInfo& route) const {
+        auto built_route = BuildRoute(from, to);
+        if (!built_route) {
+            return false;
+        }
+        route.weight = built_route->weight;
+        route.edges.assign(built_route->edges.begin(), built_route->edges.end());
+        return true;
+    }
+    // Weights of the routes from one vertex to each of the targets, nullopt for unreachable
+    // ones. Engines override it to share one search per source and skip path unpacking.
+    virtual std::vector<std::optional<Weight>> BuildWeights(VertexId from, const std::vector<VertexId>& targets) const {
+        std::vector<std::optional<Weight>> weights;
+        weights.reserve(targets.size());
+        for (const VertexId to : targets) {
+            auto route = BuildRoute(from, to);
+            weights.push_back(route ? std::optional<Weight>(route->weight) : std::nullopt);
+        }
+        return weights;
+    }
+    // Calls func for every vertex whose route from `from` weighs at most max_weight, in no
+    // particular order and without building the routes. Returns false if the engine has
+    // nothing better than a bounded search over the graph, which is then up to the caller.
+    virtual bool ForEachReachable(VertexId /*from*/, Weight /*max_weight*/, const ReachableCallback& /*func*/) const {
+        return false;
+    }
+    virtual ~RouterInterface() = default;
+};
+
+// Edge ids in the routing table take 32 bits: a table that could address more
+// edges would not fit into memory anyway
+using CompactEdgeId = uint32_t;
+
+// Stored weight of a routing table in fixed point: an unsigned count of 1 / UnitsPerWeight
+// parts of the graph weight, so the table is relaxed by integer min-plus. Weights are
+// rounded down, which keeps a stored route weight a lower bound of the exact one; sums
+// saturate at the maximum, which the table reads as the absence of a route.
+template <typename Units, uint64_t UnitsPerWeight>
+struct FixedPointWeight {
+    static_assert(std::is_unsigned_v<Units> && sizeof(Units) <= sizeof(uint32_t),
+                  "Units of a fixed point weight should be unsigned and at most 32-bit");
+
+    Units units = 0;
+
+    constexpr FixedPointWeight() = default;
+    template <typename Weight, typename = std::enable_if_t<std::is_floating_point_v<Weight>>>
+    explicit FixedPointWeight(Weight weight) {
+        const Weight scaled = weight * static_cast<Weight>(UnitsPerWeight);
+        if (!(scaled < static_cast<Weight>(std::numeric_limits<Units>::max()))) {
+            throw std::range_error("Weight does not fit into the fixed point type");
+        }
+        units = static_cast<Units>(scaled);
+    }
+
+    static constexpr FixedPointWeight FromUnits(Units units) {
+        FixedPointWeight weight;
+        weight.units = units;
+        return weight;
+    }
+
+    template <typename Weight, typename = std::enable_if_t<std::is_floating_point_v<Weight>>>
+    explicit constexpr operator Weight() const {
+        return static_cast<Weight>(units) / static_cast<Weight>(UnitsPerWeight);
+    }
+
+    friend constexpr FixedPointWeight operator+(FixedPointWeight lhs, FixedPointWeight rhs) {
+        // Without a branch on the carry, which is taken for every UNREACHABLE operand
+        const uint64_t sum = uint64_t{lhs.units} + rhs.units;
+        return FromUnits(static_cast<Units>(std::min<uint64_t>(sum, std::numeric_limits<Units>::max())));
+    }
+    friend constexpr bool operator==(FixedPointWeight lhs, FixedPointWeight rhs) {
+        return lhs.units == rhs.units;
+    }
+    friend constexpr bool operator!=(FixedPointWeight lhs, FixedPointWeight rhs) {
+        return lhs.units != rhs.units;
+    }
+    friend constexpr bool operator<(FixedPointWeight lhs, FixedPointWeight rhs) {
+        return lhs.units < rhs.units;
+    }
+    friend constexpr bool operator>(FixedPointWeight lhs, FixedPointWeight rhs) {
+        return lhs.units > rhs.units;
+    }
+};
 
-    std::optional<RouteInfo> BuildRoute(VertexId from, VertexId to) const;
+}  // namespace graph
 
+namespace std {
+
+// The maximum of a fixed point weight is the UNREACHABLE mark of a routing table
+template <typename Units, uint64_t UnitsPerWeight>
+class numeric_limits<graph::FixedPointWeight<Units, UnitsPerWeight>> {
 private:
-    struct RouteInternalData {
-        Weight weight;
-        std::optional<EdgeId> prev_edge;
+    using Weight = graph::FixedPointWeight<Units, UnitsPerWeight>;
+
+public:
+    static constexpr bool is_specialized = true;
+    static constexpr bool is_signed = false;
+    static constexpr bool is_integer = false;
+    static constexpr bool is_exact = true;
+    static constexpr bool has_infinity = false;
+
+    static constexpr Weight min() noexcept {
+        return Weight::FromUnits(0);
+    }
+    static constexpr Weight lowest() noexcept {
+        return Weight::FromUnits(0);
+    }
+    static constexpr Weight max() noexcept {
+        return Weight::FromUnits(std::numeric_limits<Units>::max());
+    }
+    static constexpr Weight infinity() noexcept {
+        return Weight{};
+    }
+};
+
+}  // namespace std
+
+namespace graph {
+
+enum class TableAlgorithm {
+    // O(V^3) tiled Floyd-Warshall, for dense graphs
+    FLOYD_WARSHALL,
+    // A Dijkstra run per source, O(V * E log V), for sparse graphs
+    DIJKSTRA
+};
+
+// StoredWeight is the type of weights kept in the table; a narrower type (float or
+// FixedPointWeight<uint32_t, N> for double weights) halves the table, while route
+// weights are still summed over the original edges in Weight
+template <typename Weight, typename StoredWeight = Weight>
+class Router : public RouterInterface<Weight> {
+private:
+    using Graph = DirectedWeightedGraph<Weight>;
+
+public:
+    using typename RouterInterface<Weight>::RouteInfo;
+    using typename RouterInterface<Weight>::ReachableCallback;
+
+    explicit Router(const Graph& graph, TableAlgorithm algorithm = TableAlgorithm::FLOYD_WARSHALL);
+    // Serves routes from a table built earlier, e.g. mapped from a file.
+    // Both matrices must outlive the router.
+    Router(const Graph& graph, const StoredWeight* weights, const CompactEdgeId* prev_edges);
+
+    // Checks the previous edges of a table that comes from outside: each is NO_EDGE or an
+    // edge of the graph into its column, and routes from a vertex to itself are empty.
+    // O(V^2), rows are checked in parallel.
+    static bool IsValidTable(const Graph& graph, const CompactEdgeId* prev_edges);
+
+    std::optional<RouteInfo> BuildRoute(VertexId from, VertexId to) const override;
+    bool BuildRouteInto(VertexId from, VertexId to, RouteInfo& route) const override;
+    // Reads the weights right from the table
+    std::vector<std::optional<Weight>> BuildWeights(VertexId from, const std::vector<VertexId>& targets) const override;
+    // Scans the row of the table
+    bool ForEachReachable(VertexId from, Weight max_weight, const ReachableCallback& func) const override;
+
+    // Takes into account the edges added to the graph after the table was built.
+    // Routes are relaxed only through the ends of the new edges, O(k * V^2) for k
+    // distinct ends instead of O(V^3) for a rebuild. An external table is copied first.
+    void AddNewEdges();
+
+    // Bytes taken by the routing table
+    size_t GetTableSize() const;
+    // Row-major vertex_count x vertex_count matrices of the table
+    const StoredWeight* GetWeights() const;
+    const CompactEdgeId* GetPrevEdges() const;
+    // Copies of the table bound to the NUMA nodes, made when the memory placement
+    // settings replicate tables and there is more than one node
+    size_t GetReplicaCount() const;
+    const StoredWeight* GetReplicaWeights(size_t node) const;
+    const CompactEdgeId* GetReplicaPrevEdges(size_t node) const;
+
+private:
+    // Floyd-Warshall runs over square tiles of the matrix: a tile of TILE_SIZE rows
+    // of weights and previous edges fits into L1/L2, and tiles of each phase are
+    // independent of each other and are relaxed in parallel
+    static constexpr size_t TILE_SIZE = 64;
+    static constexpr CompactEdgeId NO_EDGE = std::numeric_limits<CompactEdgeId>::max();
+    static constexpr StoredWeight UNREACHABLE = std::numeric_limits<StoredWeight>::has_infinity
+                                                    ? std::numeric_limits<StoredWeight>::infinity()
+                                                    : std::numeric_limits<StoredWeight>::max();
+
+    // Weights and previous edges of routes are kept in two flat row-major matrices,
+    // UNREACHABLE weight marks the absence of a route and NO_EDGE the empty route
+    struct RoutesInternalData {
+        std::vector<StoredWeight, memory::TableAllocator<StoredWeight>> weights;
+        std::vector<CompactEdgeId, memory::TableAllocator<CompactEdgeId>> prev_edges;
+    };
+
+    struct TableReplica {
+        memory::Buffer weights;
+        memory::Buffer prev_edges;
+    };
+
+    // The matrices a query reads: the copy of the node of the calling thread when the
+    // table is replicated
+    struct Table {
+        const StoredWeight* weights;
+        const CompactEdgeId* prev_edges;
     };
-    using RoutesInternalData = std::vector<std::vector<std::optional<RouteInternalData>>>;
+
+    size_t GetIndex(VertexId from, VertexId to) const {
+        return from * vertex_count_ + to;
+    }
+
+    Table GetTable() const {
+        if (replicas_.empty()) {
+            return {weights_, prev_edges_};
+        }
+        const TableReplica& replica = replicas_[memory::GetCurrentNode() % replicas_.size()];
+        return {static_cast<const StoredWeight*>(replica.weights.GetData()),
+                static_cast<const CompactEdgeId*>(replica.prev_edges.GetData())};
+    }
+
+    // Copies the table to every node if the placement settings ask for it
+    void UpdateReplicas() {
+        replicas_.clear();
+        const size_t node_count = memory::GetNodeCount();
+        if (memory::GetPlacementSettings().numa_policy_ != memory::NumaPolicy::REPLICATE || node_count <= 1) {
+            return;
+        }
+        const size_t cell_count = vertex_count_ * vertex_count_;
+        for (size_t node = 0; node < node_count; ++node) {
+            TableReplica replica{memory::Buffer(cell_count * sizeof(StoredWeight), node),
+                                 memory::Buffer(cell_count * sizeof(CompactEdgeId), node)};
+            std::memcpy(replica.weights.GetData(), weights_, cell_count * sizeof(StoredWeight));
+            std::memcpy(replica.prev_edges.GetData(), prev_edges_, cell_count * sizeof(CompactEdgeId));
+            replicas_.push_back(std::move(replica));
+        }
+    }
+
+    // Weight of a route in the table: the stored one, or the sum over the edges of the
+    // route when the table keeps a narrower type, to keep the precision of Weight
+    Weight GetRouteWeight(const Table& table, VertexId from, VertexId to) const {
+        if constexpr (std::is_same_v<Weight, StoredWeight>) {
+            return table.weights[GetIndex(from, to)];
+        } else {
+            Weight weight = ZERO_WEIGHT;
+            size_t edge_count = 0;
+            for (CompactEdgeId edge_id = table.prev_edges[GetIndex(from, to)];
+                 edge_id != NO_EDGE;
+                 edge_id = table.prev_edges[GetIndex(from, graph_.GetEdge(edge_id).from)])
+            {
+                CheckRouteLength(++edge_count);
+                weight += graph_.GetEdge(edge_id).weight;
+            }
+            return weight;
+        }
+    }
+
+    // A shortest route visits every vertex at most once, so a longer chain of previous
+    // edges means a cycle in a damaged table and would never end
+    void CheckRouteLength(size_t edge_count) const {
+        if (edge_count > vertex_count_) {
+            throw std::runtime_error("Routing table has a cycle of previous edges");
+        }
+    }
 
     void InitializeRoutesInternalData(const Graph& graph) {
-        const size_t vertex_count = graph.GetVertexCount();
-        for (VertexId vertex = 0; vertex < vertex_count; ++vertex) {
-            routes_internal_data_[vertex][vertex] = RouteInternalData{ZERO_WEIGHT, std::nullopt};
-            for (const EdgeId edge_id : graph.GetIncidentEdges(vertex)) {
-                const auto& edge = graph.GetEdge(edge_id);
-                if (edge.weight < ZERO_WEIGHT) {
+        for (VertexId vertex = 0; vertex < vertex_count_; ++vertex) {
+            routes_internal_data_.weights[GetIndex(vertex, vertex)] = STORED_ZERO_WEIGHT;
+            graph.ForEachIncidentEdge(vertex, [&](EdgeId edge_id, VertexId to, Weight edge_weight) {
+                if (edge_weight < ZERO_WEIGHT) {
                     throw std::domain_error("Edges' weights should be non-negative");
                 }
-                auto& route_internal_data = routes_internal_data_[vertex][edge.to];
-                if (!route_internal_data || route_internal_data->weight > edge.weight) {
-                    route_internal_data = RouteInternalData{edge.weight, edge_id};
+                const size_t index = GetIndex(vertex, to);
+                const StoredWeight weight = static_cast<StoredWeight>(edge_weight);
+                if (routes_internal_data_.weights[index] == UNREACHABLE
+                    || routes_internal_data_.weights[index] > weight) {
+                    routes_internal_data_.weights[index] = weight;
+                    routes_internal_data_.prev_edges[index] = static_cast<CompactEdgeId>(edge_id);
                 }
-            }
+            });
         }
     }
 
-    void RelaxRoute(VertexId vertex_from, VertexId vertex_to, const RouteInternalData& route_from,
-                    const RouteInternalData& route_to) {
-        auto& route_relaxing = routes_internal_data_[vertex_from][vertex_to];
-        const Weight candidate_weight = route_from.weight + route_to.weight;
-        if (!route_relaxing || candidate_weight < route_relaxing->weight) {
-            route_relaxing = {candidate_weight,
-                              route_to.prev_edge ? route_to.prev_edge : route_from.prev_edge};
+    // Relaxes routes of the tile (rows from tile_from, columns from tile_to) through
+    // the vertices of the tile tile_through. Rows are independent, so the inner loop
+    // is a branchless min-plus over contiguous memory that the compiler vectorizes.
+    void RelaxTile(size_t tile_from, size_t tile_to, size_t tile_through) {
+        RelaxBlock(tile_from, std::min(tile_from + TILE_SIZE, vertex_count_),
+                   tile_to, std::min(tile_to + TILE_SIZE, vertex_count_),
+                   tile_through, std::min(tile_through + TILE_SIZE, vertex_count_));
+    }
+
+    void RelaxBlock(size_t tile_from, size_t from_end, size_t tile_to, size_t to_end,
+                    size_t tile_through, size_t through_end) {
+        StoredWeight* const weights = routes_internal_data_.weights.data();
+        CompactEdgeId* const prev_edges = routes_internal_data_.prev_edges.data();
+
+        for (VertexId vertex_through = tile_through; vertex_through < through_end; ++vertex_through) {
+            const StoredWeight* const weights_through = weights + GetIndex(vertex_through, 0);
+            const CompactEdgeId* const prev_edges_through = prev_edges + GetIndex(vertex_through, 0);
+            for (VertexId vertex_from = tile_from; vertex_from < from_end; ++vertex_from) {
+                const StoredWeight weight_from = weights[GetIndex(vertex_from, vertex_through)];
+                if (weight_from == UNREACHABLE) {
+                    continue;
+                }
+                const CompactEdgeId prev_edge_from = prev_edges[GetIndex(vertex_from, vertex_through)];
+                StoredWeight* const weights_relaxing = weights + GetIndex(vertex_from, 0);
+                CompactEdgeId* const prev_edges_relaxing = prev_edges + GetIndex(vertex_from, 0);
+                for (VertexId vertex_to = tile_to; vertex_to < to_end; ++vertex_to) {
+                    const StoredWeight candidate_weight = AddWeights(weight_from, weights_through[vertex_to]);
+                    const bool is_better = candidate_weight < weights_relaxing[vertex_to];
+                    const CompactEdgeId candidate_prev_edge = prev_edges_through[vertex_to] != NO_EDGE
+                                                           ? prev_edges_through[vertex_to]
+                                                           : prev_edge_from;
+                    weights_relaxing[vertex_to] = SelectWeight(is_better, candidate_weight, weights_relaxing[vertex_to]);
+                    prev_edges_relaxing[vertex_to] = is_better ? candidate_prev_edge : prev_edges_relaxing[vertex_to];
+                }
+            }
         }
     }
 
-    void RelaxRoutesInternalDataThroughVertex(size_t vertex_count, VertexId vertex_through) {
-        for (VertexId vertex_from = 0; vertex_from < vertex_count; ++vertex_from) {
-            if (const auto& route_from = routes_internal_data_[vertex_from][vertex_through]) {
-                for (VertexId vertex_to = 0; vertex_to < vertex_count; ++vertex_to) {
-                    if (const auto& route_to = routes_internal_data_[vertex_through][vertex_to]) {
-                        RelaxRoute(vertex_from, vertex_to, *route_from, *route_to);
+    void RelaxRoutesInternalData() {
+        const size_t tile_count = (vertex_count_ + TILE_SIZE - 1) / TILE_SIZE;
+        for (size_t tile_through = 0; tile_through < tile_count; ++tile_through) {
+            const size_t through = tile_through * TILE_SIZE;
+            // The diagonal tile depends only on itself
+            RelaxTile(through, through, through);
+            // Tiles of the row and of the column of the diagonal tile depend on it only
+            parallel::ForEachIndex(2 * tile_count, [&](size_t index) {
+                const size_t other = (index / 2) * TILE_SIZE;
+                if (other == through) {
+                    return;
+                }
+                if (index % 2 == 0) {
+                    RelaxTile(through, other, through);
+                } else {
+                    RelaxTile(other, through, through);
+                }
+            });
+            // All the remaining tiles depend only on the row and the column
+            parallel::ForEachIndex(tile_count, [&](size_t tile_from) {
+                const size_t from = tile_from * TILE_SIZE;
+                if (from == through) {
+                    return;
+                }
+                for (size_t to = 0; to < vertex_count_; to += TILE_SIZE) {
+                    if (to != through) {
+                        RelaxTile(from, to, through);
                     }
                 }
+            });
+        }
+    }
+
+    // Heap of the Dijkstra runs of a thread, reused from run to run
+    struct DijkstraScratch {
+        std::vector<std::pair<StoredWeight, VertexId>> queue;
+    };
+
+    // Rows of the table are the shortest path trees of their sources: each run writes
+    // the weights and the last edges of the routes from its source right into its row,
+    // so the runs are independent and go in parallel. The weights are summed in
+    // StoredWeight along the routes, as Floyd-Warshall sums them.
+    void BuildRoutesByDijkstra(const Graph& graph) {
+        std::vector<StoredWeight> edge_weights(graph.GetEdgeCount());
+        for (EdgeId edge_id = 0; edge_id < graph.GetEdgeCount(); ++edge_id) {
+            const Weight edge_weight = graph.GetEdge(edge_id).weight;
+            if (edge_weight < ZERO_WEIGHT) {
+                throw std::domain_error("Edges' weights should be non-negative");
+            }
+            edge_weights[edge_id] = static_cast<StoredWeight>(edge_weight);
+        }
+        parallel::ForEachIndexWithState(vertex_count_, [] { return DijkstraScratch{}; },
+                                        [&](DijkstraScratch& scratch, size_t from) {
+            ComputeShortestPathTree(graph, edge_weights, static_cast<VertexId>(from), scratch);
+        });
+    }
+
+    void ComputeShortestPathTree(const Graph& graph, const std::vector<StoredWeight>& edge_weights, VertexId from,
+                                 DijkstraScratch& scratch) {
+        StoredWeight* const weights = routes_internal_data_.weights.data() + GetIndex(from, 0);
+        CompactEdgeId* const prev_edges = routes_internal_data_.prev_edges.data() + GetIndex(from, 0);
+        // Min-heap by weight; the row itself tells settled vertices from outdated items,
+        // which are heavier than the row since a vertex is pushed only on an improvement
+        const auto is_heavier = [](const std::pair<StoredWeight, VertexId>& lhs,
+                                   const std::pair<StoredWeight, VertexId>& rhs) {
+            return rhs.first < lhs.first || (!(lhs.first < rhs.first) && lhs.second > rhs.second);
+        };
+        auto& queue = scratch.queue;
+        queue.clear();
+        weights[from] = STORED_ZERO_WEIGHT;
+        queue.push_back({STORED_ZERO_WEIGHT, from});
+        while (!queue.empty()) {
+            std::pop_heap(queue.begin(), queue.end(), is_heavier);
+            const auto [weight, vertex] = queue.back();
+            queue.pop_back();
+            if (weights[vertex] < weight) {
+                continue;
+            }
+            graph.ForEachIncidentEdge(vertex, [&, weight = weight](EdgeId edge_id, VertexId to, Weight) {
+                const StoredWeight candidate_weight = AddWeights(weight, edge_weights[edge_id]);
+                if (candidate_weight < weights[to]) {
+                    weights[to] = candidate_weight;
+                    prev_edges[to] = static_cast<CompactEdgeId>(edge_id);
+                    queue.push_back({candidate_weight, to});
+                    std::push_heap(queue.begin(), queue.end(), is_heavier);
+                }
+            });
+        }
+    }
+
+    // Relaxes all the routes through one vertex; its own row can not change
+    // since routes from it to itself are empty
+    void RelaxThroughVertex(VertexId vertex_through) {
+        const size_t tile_count = (vertex_count_ + TILE_SIZE - 1) / TILE_SIZE;
+        parallel::ForEachIndex(tile_count, [&](size_t tile_from) {
+            const size_t from = tile_from * TILE_SIZE;
+            const size_t from_end = std::min(from + TILE_SIZE, vertex_count_);
+            if (from <= vertex_through && vertex_through < from_end) {
+                RelaxBlock(from, vertex_through, 0, vertex_count_, vertex_through, vertex_through + 1);
+                RelaxBlock(vertex_through + 1, from_end, 0, vertex_count_, vertex_through, vertex_through + 1);
+            } else {
+                RelaxBlock(from, from_end, 0, vertex_count_, vertex_through, vertex_through + 1);
             }
+        });
+    }
+
+    static StoredWeight AddWeights(StoredWeight lhs, StoredWeight rhs) {
+        // Infinity absorbs additions, and class weights such as FixedPointWeight saturate
+        // at the maximum, which is UNREACHABLE
+        if constexpr (std::numeric_limits<StoredWeight>::has_infinity || !std::is_arithmetic_v<StoredWeight>) {
+            return lhs + rhs;
+        } else {
+            return rhs == UNREACHABLE ? UNREACHABLE : lhs + rhs;
         }
     }
 
+    // Takes the weights by value: a conditional over lvalues of a class type such as
+    // FixedPointWeight selects an address, which keeps the loops from vectorizing
+    static StoredWeight SelectWeight(bool condition, StoredWeight lhs, StoredWeight rhs) {
+        return condition ? lhs : rhs;
+    }
+
     static constexpr Weight ZERO_WEIGHT{};
+    static constexpr StoredWeight STORED_ZERO_WEIGHT{};
     const Graph& graph_;
+    size_t vertex_count_ = 0;
+    // Number of graph edges the table accounts for
+    size_t edge_count_ = 0;
     RoutesInternalData routes_internal_data_;
+    // Point either to routes_internal_data_ or to an external table
+    const StoredWeight* weights_ = nullptr;
+    const CompactEdgeId* prev_edges_ = nullptr;
+    // Indexed by NUMA node, empty unless the table is replicated
+    std::vector<TableReplica> replicas_;
 };
 
-template <typename Weight>
-Router<Weight>::Router(const Graph& graph)
+template <typename Weight, typename StoredWeight>
+Router<Weight, StoredWeight>::Router(const Graph& graph, TableAlgorithm algorithm)
+    : graph_(graph)
+    , vertex_count_(graph.GetVertexCount())
+    , edge_count_(graph.GetEdgeCount())
+{
+    if (graph.GetEdgeCount() >= NO_EDGE) {
+        throw std::length_error("Too many edges for the routing table");
+    }
+    routes_internal_data_.weights.assign(vertex_count_ * vertex_count_, UNREACHABLE);
+    routes_internal_data_.prev_edges.assign(vertex_count_ * vertex_count_, NO_EDGE);
+    if (algorithm == TableAlgorithm::DIJKSTRA) {
+        BuildRoutesByDijkstra(graph);
+    } else {
+        InitializeRoutesInternalData(graph);
+        RelaxRoutesInternalData();
+    }
+    weights_ = routes_internal_data_.weights.data();
+    prev_edges_ = routes_internal_data_.prev_edges.data();
+    UpdateReplicas();
+}
+
+template <typename Weight, typename StoredWeight>
+Router<Weight, StoredWeight>::Router(const Graph& graph, const StoredWeight* weights, const CompactEdgeId* prev_edges)
     : graph_(graph)
-    , routes_internal_data_(graph.GetVertexCount(),
-                            std::vector<std::optional<RouteInternalData>>(graph.GetVertexCount()))
+    , vertex_count_(graph.GetVertexCount())
+    , edge_count_(graph.GetEdgeCount())
+    , weights_(weights)
+    , prev_edges_(prev_edges)
 {
-    InitializeRoutesInternalData(graph);
+    UpdateReplicas();
+}
 
+template <typename Weight, typename StoredWeight>
+bool Router<Weight, StoredWeight>::IsValidTable(const Graph& graph, const CompactEdgeId* prev_edges) {
     const size_t vertex_count = graph.GetVertexCount();
-    for (VertexId vertex_through = 0; vertex_through < vertex_count; ++vertex_through) {
-        RelaxRoutesInternalDataThroughVertex(vertex_count, vertex_through);
-    }
+    const size_t edge_count = graph.GetEdgeCount();
+    std::atomic<bool> is_valid{true};
+    parallel::ForEachIndex(vertex_count, [&](size_t from) {
+        const CompactEdgeId* const row = prev_edges + from * vertex_count;
+        if (row[from] != NO_EDGE) {
+            is_valid = false;
+            return;
+        }
+        for (VertexId to = 0; to < vertex_count; ++to) {
+            if (row[to] != NO_EDGE && (row[to] >= edge_count || graph.GetEdge(row[to]).to != to)) {
+                is_valid = false;
+                return;
+            }
+        }
+    });
+    return is_valid;
 }
 
-template <typename Weight>
-std::optional<typename Router<Weight>::RouteInfo> Router<Weight>::BuildRoute(VertexId from,
-                                                                             VertexId to) const {
-    const auto& route_internal_data = routes_internal_data_.at(from).at(to);
-    if (!route_internal_data) {
+template <typename Weight, typename StoredWeight>
+std::optional<typename Router<Weight, StoredWeight>::RouteInfo>
+Router<Weight, StoredWeight>::BuildRoute(VertexId from, VertexId to) const {
+    RouteInfo route;
+    if (!BuildRouteInto(from, to, route)) {
         return std::nullopt;
     }
-    const Weight weight = route_internal_data->weight;
-    std::vector<EdgeId> edges;
-    for (std::optional<EdgeId> edge_id = route_internal_data->prev_edge;
-         edge_id;
-         edge_id = routes_internal_data_[from][graph_.GetEdge(*edge_id).from]->prev_edge)
+    return route;
+}
+
+template <typename Weight, typename StoredWeight>
+bool Router<Weight, StoredWeight>::BuildRouteInto(VertexId from, VertexId to, RouteInfo& route) const {
+    if (from >= vertex_count_ || to >= vertex_count_) {
+        throw std::out_of_range("Vertex id is out of range");
+    }
+    const Table table = GetTable();
+    const StoredWeight stored_weight = table.weights[GetIndex(from, to)];
+    if (stored_weight == UNREACHABLE) {
+        return false;
+    }
+    route.edges.clear();
+    for (CompactEdgeId edge_id = table.prev_edges[GetIndex(from, to)];
+         edge_id != NO_EDGE;
+         edge_id = table.prev_edges[GetIndex(from, graph_.GetEdge(edge_id).from)])
     {
-        edges.push_back(*edge_id);
+        route.edges.push_back(edge_id);
+        CheckRouteLength(route.edges.size());
+    }
+    std::reverse(route.edges.begin(), route.edges.end());
+
+    if constexpr (std::is_same_v<Weight, StoredWeight>) {
+        route.weight = stored_weight;
+    } else {
+        route.weight = ZERO_WEIGHT;
+        for (const EdgeId edge_id : route.edges) {
+            route.weight += graph_.GetEdge(edge_id).weight;
+        }
+    }
+    return true;
+}
+
+template <typename Weight, typename StoredWeight>
+std::vector<std::optional<Weight>> Router<Weight, StoredWeight>::BuildWeights(VertexId from,
+                                                                             const std::vector<VertexId>& targets) const {
+    if (from >= vertex_count_) {
+        throw std::out_of_range("Vertex id is out of range");
+    }
+    const Table table = GetTable();
+    std::vector<std::optional<Weight>> weights;
+    weights.reserve(targets.size());
+    for (const VertexId to : targets) {
+        if (to >= vertex_count_) {
+            throw std::out_of_range("Vertex id is out of range");
+        }
+        if (table.weights[GetIndex(from, to)] == UNREACHABLE) {
+            weights.push_back(std::nullopt);
+        } else {
+            weights.push_back(GetRouteWeight(table, from, to));
+        }
+    }
+    return weights;
+}
+
+template <typename Weight, typename StoredWeight>
+bool Router<Weight, StoredWeight>::ForEachReachable(VertexId from, Weight max_weight, const ReachableCallback& func) const {
+    if (from >= vertex_count_) {
+        throw std::out_of_range("Vertex id is out of range");
+    }
+    // Stored weights of a narrower type are off by the rounding, so the ones slightly
+    // above the budget are checked against the exact weight
+    const Weight stored_max_weight = std::is_same_v<Weight, StoredWeight> ? max_weight : max_weight + max_weight / 1024;
+    const Table table = GetTable();
+    const StoredWeight* const row = table.weights + GetIndex(from, 0);
+    for (VertexId to = 0; to < vertex_count_; ++to) {
+        if (row[to] == UNREACHABLE || static_cast<Weight>(row[to]) > stored_max_weight) {
+            continue;
+        }
+        const Weight weight = GetRouteWeight(table, from, to);
+        if (!(max_weight < weight)) {
+            func(to, weight);
+        }
+    }
+    return true;
+}
+
+template <typename Weight, typename StoredWeight>
+void Router<Weight, StoredWeight>::AddNewEdges() {
+    const size_t edge_count = graph_.GetEdgeCount();
+    if (edge_count == edge_count_) {
+        return;
     }
-    std::reverse(edges.begin(), edges.end());
+    if (graph_.GetVertexCount() != vertex_count_) {
+        throw std::logic_error("Vertices can not be added to a built routing table");
+    }
+    if (edge_count >= NO_EDGE) {
+        throw std::length_error("Too many edges for the routing table");
+    }
+    if (weights_ != routes_internal_data_.weights.data()) {
+        routes_internal_data_.weights.assign(weights_, weights_ + vertex_count_ * vertex_count_);
+        routes_internal_data_.prev_edges.assign(prev_edges_, prev_edges_ + vertex_count_ * vertex_count_);
+        weights_ = routes_internal_data_.weights.data();
+        prev_edges_ = routes_internal_data_.prev_edges.data();
+    }
+
+    // The old table holds shortest routes over the old edges, so any new shortest route
+    // is a chain of old routes joined at the ends of the new edges: relaxing through
+    // those ends alone restores the table
+    std::vector<VertexId> vertices_through;
+    for (EdgeId edge_id = edge_count_; edge_id < edge_count; ++edge_id) {
+        const auto& edge = graph_.GetEdge(edge_id);
+        if (edge.weight < ZERO_WEIGHT) {
+            throw std::domain_error("Edges' weights should be non-negative");
+        }
+        const size_t index = GetIndex(edge.from, edge.to);
+        const StoredWeight weight = static_cast<StoredWeight>(edge.weight);
+        if (routes_internal_data_.weights[index] > weight) {
+            routes_internal_data_.weights[index] = weight;
+            routes_internal_data_.prev_edges[index] = static_cast<CompactEdgeId>(edge_id);
+        }
+        vertices_through.push_back(edge.from);
+        vertices_through.push_back(edge.to);
+    }
+    std::sort(vertices_through.begin(), vertices_through.end());
+    vertices_through.erase(std::unique(vertices_through.begin(), vertices_through.end()), vertices_through.end());
+    for (const VertexId vertex_through : vertices_through) {
+        RelaxThroughVertex(vertex_through);
+    }
+    edge_count_ = edge_count;
+    UpdateReplicas();
+}
+
+template <typename Weight, typename StoredWeight>
+size_t Router<Weight, StoredWeight>::GetTableSize() const {
+    return vertex_count_ * vertex_count_ * (sizeof(StoredWeight) + sizeof(CompactEdgeId));
+}
+
+template <typename Weight, typename StoredWeight>
+const StoredWeight* Router<Weight, StoredWeight>::GetWeights() const {
+    return weights_;
+}
+
+template <typename Weight, typename StoredWeight>
+const CompactEdgeId* Router<Weight, StoredWeight>::GetPrevEdges() const {
+    return prev_edges_;
+}
+
+template <typename Weight, typename StoredWeight>
+size_t Router<Weight, StoredWeight>::GetReplicaCount() const {
+    return replicas_.size();
+}
+
+template <typename Weight, typename StoredWeight>
+const StoredWeight* Router<Weight, StoredWeight>::GetReplicaWeights(size_t node) const {
+    return static_cast<const StoredWeight*>(replicas_.at(node).weights.GetData());
+}
 
-    return RouteInfo{weight, std::move(edges)};
+template <typename Weight, typename StoredWeight>
+const CompactEdgeId* Router<Weight, StoredWeight>::GetReplicaPrevEdges(size_t node) const {
+    return static_cast<const CompactEdgeId*>(replicas_.at(node).prev_edges.GetData());
 }
 
 }  // namespace graph
\ No newline at end of file
@@ -0,0 +1,236 @@
+#include "router_file.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace transport_router
+{
+    namespace
+    {
+        constexpr uint64_t SECTION_ALIGNMENT = 64;
+
+        uint64_t AlignOffset(uint64_t offset)
+        {
+            return (offset + SECTION_ALIGNMENT - 1) / SECTION_ALIGNMENT * SECTION_ALIGNMENT;
+        }
+
+        void WritePadding(std::ofstream& out, uint64_t offset)
+        {
+            static const char zeros[SECTION_ALIGNMENT] = {};
+            const uint64_t position = static_cast<uint64_t>(out.tellp());
+            out.write(zeros, static_cast<std::streamsize>(offset - position));
+        }
+
+        template <typename T>
+        void WriteArray(std::ofstream& out, const std::vector<T>& values)
+        {
+            out.write(reinterpret_cast<const char*>(values.data()), static_cast<std::streamsize>(values.size() * sizeof(T)));
+        }
+
+        template <typename T>
+        bool ReadArray(std::ifstream& in, std::vector<T>& values, uint64_t size)
+        {
+            values.resize(size);
+            in.read(reinterpret_cast<char*>(values.data()), static_cast<std::streamsize>(size * sizeof(T)));
+            return static_cast<bool>(in);
+        }
+
+        void WriteLabels(std::ofstream& out, const graph::HubLabels<double>& labels)
+        {
+            WriteArray(out, labels.offsets);
+            WriteArray(out, labels.hubs);
+            WriteArray(out, labels.weights);
+            WriteArray(out, labels.edges);
+        }
+
+        bool ReadLabels(std::ifstream& in, graph::HubLabels<double>& labels, uint64_t vertex_count, uint64_t entry_count)
+        {
+            return ReadArray(in, labels.offsets, vertex_count + 1) && ReadArray(in, labels.hubs, entry_count)
+                   && ReadArray(in, labels.weights, entry_count) && ReadArray(in, labels.edges, entry_count);
+        }
+    }
+
+    void WriteRouterFile(const std::string& path, RouterFileHeader header, const std::vector<RouterFileEdge>& edges,
+                         const void* weights, const uint32_t* prev_edges)
+    {
+        const uint64_t cell_count = header.vertex_count * header.vertex_count;
+        std::memcpy(header.magic, RouterFileHeader::MAGIC, sizeof(header.magic));
+        header.version = RouterFileHeader::VERSION;
+        header.edge_count = edges.size();
+        header.edges_offset = AlignOffset(sizeof(RouterFileHeader));
+        header.weights_offset = AlignOffset(header.edges_offset + edges.size() * sizeof(RouterFileEdge));
+        header.prev_edges_offset = AlignOffset(header.weights_offset + cell_count * header.weight_size);
+        header.file_size = header.prev_edges_offset + cell_count * sizeof(uint32_t);
+
+        const std::string temp_path = path + ".tmp";
+        {
+            std::ofstream out(temp_path, std::ios::binary | std::ios::trunc);
+            if(!out)
+            {
+                throw std::runtime_error("Can not write router file " + temp_path);
+            }
+            out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+            WritePadding(out, header.edges_offset);
+            out.write(reinterpret_cast<const char*>(edges.data()), static_cast<std::streamsize>(edges.size() * sizeof(RouterFileEdge)));
+            WritePadding(out, header.weights_offset);
+            out.write(static_cast<const char*>(weights), static_cast<std::streamsize>(cell_count * header.weight_size));
+            WritePadding(out, header.prev_edges_offset);
+            out.write(reinterpret_cast<const char*>(prev_edges), static_cast<std::streamsize>(cell_count * sizeof(uint32_t)));
+            if(!out)
+            {
+                throw std::runtime_error("Can not write router file " + temp_path);
+            }
+        }
+        if(std::rename(temp_path.c_str(), path.c_str()) != 0)
+        {
+            std::remove(temp_path.c_str());
+            throw std::runtime_error("Can not write router file " + path);
+        }
+    }
+
+    MappedRouterFile::MappedRouterFile(const std::string& path)
+    {
+        const int fd = open(path.c_str(), O_RDONLY);
+        if(fd < 0)
+        {
+            return;
+        }
+        struct stat file_stat;
+        if(fstat(fd, &file_stat) == 0 && static_cast<size_t>(file_stat.st_size) >= sizeof(RouterFileHeader))
+        {
+            void* data = mmap(nullptr, static_cast<size_t>(file_stat.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+            if(data != MAP_FAILED)
+            {
+                data_ = static_cast<const char*>(data);
+                size_ = static_cast<size_t>(file_stat.st_size);
+            }
+        }
+        close(fd);
+        if(!data_)
+        {
+            return;
+        }
+
+        const RouterFileHeader& header = GetHeader();
+        const uint64_t cell_count = header.vertex_count * header.vertex_count;
+        is_valid_ = header.vertex_count < (uint64_t{1} << 32)
+                    && std::equal(std::begin(header.magic), std::end(header.magic), std::begin(RouterFileHeader::MAGIC))
+                    && header.version == RouterFileHeader::VERSION
+                    && header.weight_type <= RouterFileWeightType::DECISECONDS
+                    && header.weight_size == (header.weight_type == RouterFileWeightType::DOUBLE ? sizeof(double) : sizeof(uint32_t))
+                    && header.file_size == size_
+                    && header.edges_offset + header.edge_count * sizeof(RouterFileEdge) <= header.weights_offset
+                    && header.weights_offset + cell_count * header.weight_size <= header.prev_edges_offset
+                    && header.prev_edges_offset + cell_count * sizeof(uint32_t) == header.file_size;
+    }
+
+    MappedRouterFile::~MappedRouterFile()
+    {
+        if(data_)
+        {
+            munmap(const_cast<char*>(data_), size_);
+        }
+    }
+
+    bool MappedRouterFile::IsValid() const
+    {
+        return is_valid_;
+    }
+
+    const RouterFileHeader& MappedRouterFile::GetHeader() const
+    {
+        return *reinterpret_cast<const RouterFileHeader*>(data_);
+    }
+
+    const RouterFileEdge* MappedRouterFile::GetEdges() const
+    {
+        return reinterpret_cast<const RouterFileEdge*>(data_ + GetHeader().edges_offset);
+    }
+
+    const void* MappedRouterFile::GetWeights() const
+    {
+        return data_ + GetHeader().weights_offset;
+    }
+
+    const uint32_t* MappedRouterFile::GetPrevEdges() const
+    {
+        return reinterpret_cast<const uint32_t*>(data_ + GetHeader().prev_edges_offset);
+    }
+
+    void WriteHubLabelFile(const std::string& path, uint64_t checksum, const graph::HubLabelRouter<double>& router,
+                           size_t edge_count)
+    {
+        HubLabelFileHeader header;
+        std::memcpy(header.magic, HubLabelFileHeader::MAGIC, sizeof(header.magic));
+        header.version = HubLabelFileHeader::VERSION;
+        header.checksum = checksum;
+        header.vertex_count = router.GetHubVertices().size();
+        header.edge_count = edge_count;
+        header.out_entry_count = router.GetOutLabels().hubs.size();
+        header.in_entry_count = router.GetInLabels().hubs.size();
+
+        // Same temporary file dance as for the router file
+        const std::string temp_path = path + ".tmp";
+        {
+            std::ofstream out(temp_path, std::ios::binary | std::ios::trunc);
+            if(!out)
+            {
+                throw std::runtime_error("Can not write hub label file " + temp_path);
+            }
+            out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+            WriteArray(out, router.GetHubVertices());
+            WriteLabels(out, router.GetOutLabels());
+            WriteLabels(out, router.GetInLabels());
+            if(!out)
+            {
+                throw std::runtime_error("Can not write hub label file " + temp_path);
+            }
+        }
+        if(std::rename(temp_path.c_str(), path.c_str()) != 0)
+        {
+            std::remove(temp_path.c_str());
+            throw std::runtime_error("Can not write hub label file " + path);
+        }
+    }
+
+    bool ReadHubLabelFile(const std::string& path, uint64_t checksum, size_t vertex_count, size_t edge_count,
+                          std::vector<graph::VertexId>& hub_vertices, graph::HubLabels<double>& out_labels,
+                          graph::HubLabels<double>& in_labels)
+    {
+        std::ifstream in(path, std::ios::binary);
+        if(!in)
+        {
+            return false;
+        }
+        HubLabelFileHeader header;
+        in.read(reinterpret_cast<char*>(&header), sizeof(header));
+        if(!in || !std::equal(std::begin(header.magic), std::end(header.magic), std::begin(HubLabelFileHeader::MAGIC))
+            || header.version != HubLabelFileHeader::VERSION || header.checksum != checksum
+            || header.vertex_count != vertex_count || header.edge_count != edge_count)
+        {
+            return false;
+        }
+        // Entry counts come from the file, so check them against its size before allocating
+        const std::streamoff header_end = in.tellg();
+        in.seekg(0, std::ios::end);
+        const uint64_t data_size = static_cast<uint64_t>(in.tellg() - header_end);
+        const uint64_t entry_size = sizeof(uint32_t) + sizeof(double) + sizeof(graph::EdgeId);
+        if(header.out_entry_count > data_size / entry_size || header.in_entry_count > data_size / entry_size
+            || data_size != vertex_count * sizeof(graph::VertexId) + 2 * (vertex_count + 1) * sizeof(uint64_t)
+                                + (header.out_entry_count + header.in_entry_count) * entry_size)
+        {
+            return false;
+        }
+        in.seekg(header_end);
+        return ReadArray(in, hub_vertices, vertex_count) && ReadLabels(in, out_labels, vertex_count, header.out_entry_count)
+               && ReadLabels(in, in_labels, vertex_count, header.in_entry_count);
+    }
+}
@@ -0,0 +1,110 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include "hub_label_router.h"
+
+namespace transport_router
+{
+    // TableWeight lists the types in the same order
+    enum class RouterFileWeightType : uint32_t {
+        DOUBLE = 0,
+        FLOAT = 1,
+        // Unsigned 32-bit count of tenths of a second
+        DECISECONDS = 2
+    };
+
+    // Binary file with a built router: the graph edges with their metadata and the
+    // all-pairs routing table. Sections are aligned so that the table can be used
+    // right from the mapped memory.
+    struct RouterFileHeader {
+        static constexpr char MAGIC[8] = {'T', 'C', 'R', 'O', 'U', 'T', 'E', 'R'};
+        static constexpr uint32_t VERSION = 2;
+
+        char magic[8] = {};
+        uint32_t version = 0;
+        // Size of a stored weight: 8 for double, 4 for float and decisecond tables
+        uint32_t weight_size = 0;
+        RouterFileWeightType weight_type = RouterFileWeightType::DOUBLE;
+        uint32_t reserved = 0;
+        // Checksum of the catalogue and of the routing settings the router was built from
+        uint64_t checksum = 0;
+        uint64_t vertex_count = 0;
+        uint64_t edge_count = 0;
+        uint64_t edges_offset = 0;
+        uint64_t weights_offset = 0;
+        uint64_t prev_edges_offset = 0;
+        uint64_t file_size = 0;
+    };
+
+    enum class RouterFileEdgeKind : uint32_t {
+        WAIT = 0,
+        BUS = 1,
+        BOARD = 2,
+        ALIGHT = 3
+    };
+
+    struct RouterFileEdge {
+        double weight = 0.0;
+        uint32_t from = 0;
+        uint32_t to = 0;
+        RouterFileEdgeKind kind = RouterFileEdgeKind::WAIT;
+        // Index of the stop for wait edges and of the bus for bus edges in the catalogue
+        uint32_t owner_index = 0;
+        uint32_t span_count = 0;
+        uint32_t reserved = 0;
+    };
+
+    // Writes the file through a temporary one, so a concurrently starting process
+    // never maps a half-written file
+    void WriteRouterFile(const std::string& path, RouterFileHeader header, const std::vector<RouterFileEdge>& edges,
+                         const void* weights, const uint32_t* prev_edges);
+
+    // Read-only mapping of a router file
+    class MappedRouterFile {
+        public:
+        explicit MappedRouterFile(const std::string& path);
+        MappedRouterFile(const MappedRouterFile&) = delete;
+        MappedRouterFile& operator=(const MappedRouterFile&) = delete;
+        ~MappedRouterFile();
+
+        // False if the file is missing, truncated or written by another version
+        bool IsValid() const;
+        const RouterFileHeader& GetHeader() const;
+        const RouterFileEdge* GetEdges() const;
+        const void* GetWeights() const;
+        const uint32_t* GetPrevEdges() const;
+
+        private:
+        const char* data_ = nullptr;
+        size_t size_ = 0;
+        bool is_valid_ = false;
+    };
+
+    // Binary file with the hub labels of the routing graph. The graph itself is cheap to
+    // rebuild from the catalogue, so the file keeps only the labels.
+    struct HubLabelFileHeader {
+        static constexpr char MAGIC[8] = {'T', 'C', 'L', 'A', 'B', 'E', 'L', 'S'};
+        static constexpr uint32_t VERSION = 1;
+
+        char magic[8] = {};
+        uint32_t version = 0;
+        uint32_t reserved = 0;
+        // Checksum of the catalogue and of the routing settings the labels were built from
+        uint64_t checksum = 0;
+        uint64_t vertex_count = 0;
+        uint64_t edge_count = 0;
+        uint64_t out_entry_count = 0;
+        uint64_t in_entry_count = 0;
+    };
+
+    void WriteHubLabelFile(const std::string& path, uint64_t checksum, const graph::HubLabelRouter<double>& router,
+                           size_t edge_count);
+    // False if the file is missing, damaged or was built for another graph
+    bool ReadHubLabelFile(const std::string& path, uint64_t checksum, size_t vertex_count, size_t edge_count,
+                          std::vector<graph::VertexId>& hub_vertices, graph::HubLabels<double>& out_labels,
+                          graph::HubLabels<double>& in_labels);
+}
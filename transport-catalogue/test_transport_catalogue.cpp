@@ -7,6 +7,36 @@
 #include <optional>
 
 #include "geo.h"
+#include "component_router.h"
+#include "graph.h"
+#include "router.h"
+#include "astar_router.h"
+#include "contraction_hierarchy_router.h"
+#include "dijkstra_router.h"
+#include "hub_label_router.h"
+#include "json_reader.h"
+#include "lru_cache.h"
+#include "memory_placement.h"
+#include "overlay_router.h"
+#include "parallel.h"
+#include "router_file.h"
+#include "transport_router.h"
+
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <limits>
+#include <memory>
+#include <new>
+#include <random>
+#include <map>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+#include <type_traits>
+#include <variant>
+#include <vector>
 
 const double EPSILON = 1E-6;
 
@@ -71,8 +101,8 @@ void TestTransportCatalogue()
         stop1 = catalogue.AddStop(stop1);
         stop2 = catalogue.AddStop(stop2);
         stop3 = catalogue.AddStop(stop3);
-        double distance = ComputeDistance({55.611087, 37.208290}, {55.595884, 37.209755});
-        distance+= ComputeDistance({55.595884, 37.209755}, {55.632761, 37.333324});
+        double distance = geo::ComputeDistance({55.611087, 37.208290}, {55.595884, 37.209755});
+        distance+= geo::ComputeDistance({55.595884, 37.209755}, {55.632761, 37.333324});
         Bus bus = {"Bus"s, {&stop1, &stop2, &stop3}};
         Bus bus_copy = bus;
         bus = catalogue.AddRoute(bus);
@@ -91,7 +121,7 @@ void TestTransportCatalogue()
         stop1 = catalogue.AddStop(stop1);
         stop2 = catalogue.AddStop(stop2);
         stop3 = catalogue.AddStop(stop3);
-        double distance = ComputeDistance({55.611087, 37.208290}, {55.632761, 37.333324});
+        double distance = geo::ComputeDistance({55.611087, 37.208290}, {55.632761, 37.333324});
         Bus bus = {"Bus"s, {&stop1, &stop2, &stop3}};
         Bus bus_copy = bus;
         bus = catalogue.AddRoute(bus);
@@ -110,7 +140,7 @@ void TestTransportCatalogue()
         stop2 = catalogue.AddStop(stop2);
         assert(stop1 == stop2);
         stop3 = catalogue.AddStop(stop3);
-        double distance = ComputeDistance({55.611087, 37.208290}, {55.632761, 37.333324});
+        double distance = geo::ComputeDistance({55.611087, 37.208290}, {55.632761, 37.333324});
         Bus bus = {"Bus"s, {&stop1, &stop2, &stop3}};
         bus = catalogue.AddRoute(bus);
         optional<RouteInfo> info = catalogue.GetInfoAboutRoute("Bus"s);
@@ -127,13 +157,1217 @@ void TestTransportCatalogue()
         stop2 = catalogue.AddStop(stop2);
         assert(stop1 == stop2);
         stop3 = catalogue.AddStop(stop3);
-        double distance = ComputeDistance({55.611087, 37.208290}, {55.632761, 37.333324});
+        double distance = geo::ComputeDistance({55.611087, 37.208290}, {55.632761, 37.333324});
         std::vector<string> stop_names = {"stop1"s, "stop1"s, "stop2"s};
         std::string bus_name = "Bus";
-        Bus bus = catalogue.AddRoute(bus_name, stop_names.begin(), stop_names.end());
+        Bus bus = catalogue.AddRoute(bus_name, stop_names.begin(), stop_names.end(), false);
         optional<RouteInfo> info = catalogue.GetInfoAboutRoute("Bus"s);
         assert(info.value().number_of_stops_ == 3);
         assert(info.value().number_of_uniq_stops_ == 2);
         assert(std::abs(info.value().route_length_ - distance) < EPSILON);
     }
+}
+
+namespace
+{
+    // Random weights make equal routes improbable, so engines have to agree on the edges too
+    graph::DirectedWeightedGraph<double> MakeRandomGraph(size_t vertex_count, size_t edge_count, unsigned seed)
+    {
+        mt19937 generator(seed);
+        uniform_int_distribution<graph::VertexId> vertex_distribution(0, static_cast<graph::VertexId>(vertex_count - 1));
+        uniform_real_distribution<double> weight_distribution(1.0, 10.0);
+        graph::DirectedWeightedGraph<double> graph(vertex_count);
+        for(size_t i = 0; i < edge_count; ++i)
+        {
+            graph.AddEdge({vertex_distribution(generator), vertex_distribution(generator), weight_distribution(generator)});
+        }
+        return graph;
+    }
+
+    // Routes of the engine between every pair of vertices equal the ones of the all-pairs table
+    void AssertSameRoutes(const graph::RouterInterface<double>& router, const graph::Router<double>& expected,
+                          size_t vertex_count)
+    {
+        for(graph::VertexId from = 0; from < vertex_count; ++from)
+        {
+            for(graph::VertexId to = 0; to < vertex_count; ++to)
+            {
+                const auto route = router.BuildRoute(from, to);
+                const auto expected_route = expected.BuildRoute(from, to);
+                assert(route.has_value() == expected_route.has_value());
+                if(route)
+                {
+                    assert(std::abs(route->weight - expected_route->weight) < EPSILON);
+                    assert(route->edges == expected_route->edges);
+                }
+            }
+        }
+    }
+
+    // Same for the weights from every vertex to all the others in one BuildWeights call
+    void AssertSameWeights(const graph::RouterInterface<double>& router, const graph::Router<double>& expected,
+                           size_t vertex_count)
+    {
+        vector<graph::VertexId> targets(vertex_count);
+        for(graph::VertexId to = 0; to < vertex_count; ++to)
+        {
+            targets[to] = to;
+        }
+        for(graph::VertexId from = 0; from < vertex_count; ++from)
+        {
+            const auto weights = router.BuildWeights(from, targets);
+            const auto expected_weights = expected.BuildWeights(from, targets);
+            for(size_t i = 0; i < vertex_count; ++i)
+            {
+                assert(weights[i].has_value() == expected_weights[i].has_value());
+                assert(!weights[i] || std::abs(*weights[i] - *expected_weights[i]) < EPSILON);
+            }
+        }
+    }
+}
+
+void TestContractionHierarchyRouter()
+{
+    {
+        // 0 -> 1 -> 2 is shorter than the direct edge, nothing leads to 3
+        graph::DirectedWeightedGraph<double> graph(4);
+        graph.AddEdge({0, 2, 5.0});
+        const graph::EdgeId first = graph.AddEdge({0, 1, 1.0});
+        const graph::EdgeId second = graph.AddEdge({1, 2, 2.0});
+        graph.AddEdge({3, 0, 1.0});
+        const graph::ContractionHierarchyRouter<double> router(graph);
+
+        const auto route = router.BuildRoute(0, 2);
+        assert(route && std::abs(route->weight - 3.0) < EPSILON);
+        assert((route->edges == vector<graph::EdgeId>{first, second}));
+        assert(!router.BuildRoute(0, 3));
+        assert(!router.BuildRoute(2, 0));
+
+        const auto empty_route = router.BuildRoute(1, 1);
+        assert(empty_route && empty_route->weight == 0.0 && empty_route->edges.empty());
+
+        const auto weights = router.BuildWeights(0, {0, 1, 2, 3});
+        assert(weights[0] == 0.0 && std::abs(*weights[2] - 3.0) < EPSILON && !weights[3]);
+    }
+    {
+        const size_t vertex_count = 60;
+        for(unsigned seed = 1; seed <= 3; ++seed)
+        {
+            const auto graph = MakeRandomGraph(vertex_count, 150, seed);
+            const graph::Router<double> expected(graph);
+            const graph::ContractionHierarchyRouter<double> router(graph);
+            AssertSameRoutes(router, expected, vertex_count);
+            AssertSameWeights(router, expected, vertex_count);
+        }
+    }
+}
+
+void TestParallelForEachIndex()
+{
+    {
+        vector<atomic<int>> calls(1000);
+        parallel::ForEachIndex(calls.size(), [&calls](size_t index) {
+            ++calls[index];
+        });
+        assert(all_of(calls.begin(), calls.end(), [](const atomic<int>& count) { return count == 1; }));
+    }
+    {
+        // An exception of a worker reaches the caller after all the threads are joined
+        atomic<size_t> call_count{0};
+        bool is_thrown = false;
+        try
+        {
+            parallel::ForEachIndex(1000, [&call_count](size_t index) {
+                ++call_count;
+                if(index % 100 == 7)
+                {
+                    throw out_of_range("index "s + to_string(index));
+                }
+            });
+        }
+        catch(const out_of_range&)
+        {
+            is_thrown = true;
+        }
+        assert(is_thrown);
+        assert(call_count < 1000);
+    }
+    {
+        bool is_thrown = false;
+        try
+        {
+            parallel::ForEachIndexWithState(100, []() -> int { throw bad_alloc(); }, [](int, size_t) {});
+        }
+        catch(const bad_alloc&)
+        {
+            is_thrown = true;
+        }
+        assert(is_thrown);
+    }
+}
+
+namespace
+{
+    void AddTestStops(transport_catalogue::TransportCatalogue& catalogue, size_t stop_count, mt19937& generator)
+    {
+        uniform_real_distribution<double> coordinate_distribution(0.0, 0.05);
+        for(size_t i = 0; i < stop_count; ++i)
+        {
+            Stop stop = {"stop"s + to_string(i), {55.6 + coordinate_distribution(generator), 37.5 + coordinate_distribution(generator)}};
+            catalogue.AddStop(stop);
+        }
+    }
+
+    // Adds a bus over random stops of the candidates that shares no pair of neighbouring
+    // stops with the buses of the catalogue, so no two routes take the same time
+    void AddTestBus(transport_catalogue::TransportCatalogue& catalogue, const vector<string_view>& candidates,
+                    mt19937& generator)
+    {
+        set<pair<string_view, string_view>> used_pairs;
+        for(const Bus& bus : catalogue.GetAllRoutes())
+        {
+            for(size_t i = 0; i + 1 < bus.route_.size(); ++i)
+            {
+                used_pairs.insert(minmax<string_view>(bus.route_[i]->stop_name_, bus.route_[i + 1]->stop_name_));
+            }
+        }
+        uniform_int_distribution<size_t> stop_distribution(0, candidates.size() - 1);
+        uniform_int_distribution<size_t> length_distribution(2, min<size_t>(6, candidates.size()));
+        while(true)
+        {
+            vector<string_view> route(length_distribution(generator));
+            for(string_view& stop : route)
+            {
+                stop = candidates[stop_distribution(generator)];
+            }
+            set<pair<string_view, string_view>> pairs;
+            for(size_t i = 0; i + 1 < route.size(); ++i)
+            {
+                pairs.insert(minmax(route[i], route[i + 1]));
+            }
+            if(pairs.size() + 1 == route.size() && none_of(pairs.begin(), pairs.end(), [&used_pairs](const auto& stop_pair) {
+                   return stop_pair.first == stop_pair.second || used_pairs.count(stop_pair);
+               }))
+            {
+                const string bus_name = "bus"s + to_string(catalogue.GetAllRoutes().size());
+                catalogue.AddRoute(bus_name, route.begin(), route.end(), false);
+                return;
+            }
+        }
+    }
+
+    // The last two stops get no buses
+    void FillTestCatalogue(transport_catalogue::TransportCatalogue& catalogue, size_t stop_count, size_t bus_count,
+                           unsigned seed)
+    {
+        mt19937 generator(seed);
+        AddTestStops(catalogue, stop_count, generator);
+        vector<string_view> candidates;
+        for(const Stop& stop : catalogue.GetAllStops())
+        {
+            candidates.push_back(stop.stop_name_);
+        }
+        candidates.resize(stop_count - 2);
+        for(size_t bus = 0; bus < bus_count; ++bus)
+        {
+            AddTestBus(catalogue, candidates, generator);
+        }
+    }
+
+    void AssertSameRouteItems(const transport_router::BuildedRoute& route, const transport_router::BuildedRoute& expected)
+    {
+        assert(std::abs(route.total_weight_ - expected.total_weight_) < EPSILON);
+        assert(route.items_.size() == expected.items_.size());
+        for(size_t i = 0; i < route.items_.size(); ++i)
+        {
+            assert(route.items_[i].index() == expected.items_[i].index());
+            if(const auto* wait = get_if<WaitRouteItem>(&route.items_[i]))
+            {
+                const auto& expected_wait = get<WaitRouteItem>(expected.items_[i]);
+                assert(wait->stop_name_ == expected_wait.stop_name_ && wait->time_ == expected_wait.time_);
+            }
+            else
+            {
+                const auto& ride = get<BusRouteItem>(route.items_[i]);
+                const auto& expected_ride = get<BusRouteItem>(expected.items_[i]);
+                assert(ride.bus_ == expected_ride.bus_ && ride.span_count_ == expected_ride.span_count_);
+                assert(std::abs(ride.time_ - expected_ride.time_) < EPSILON);
+            }
+        }
+    }
+
+    // Routes between every pair of stops, the stops without buses included
+    void AssertSameStopRoutes(const transport_router::Router& router, const transport_router::Router& expected,
+                              const transport_catalogue::TransportCatalogue& catalogue)
+    {
+        for(const Stop& from : catalogue.GetAllStops())
+        {
+            for(const Stop& to : catalogue.GetAllStops())
+            {
+                const auto route = router.BuildRoute(from.stop_name_, to.stop_name_);
+                const auto expected_route = expected.BuildRoute(from.stop_name_, to.stop_name_);
+                assert(route.has_value() == expected_route.has_value());
+                if(route)
+                {
+                    AssertSameRouteItems(*route, *expected_route);
+                }
+            }
+        }
+    }
+
+    void SetTestRouteSettings(transport_router::Router& router)
+    {
+        router.SetRouteSettings(6, 40.0);
+    }
+}
+
+void TestRouterFile()
+{
+    using namespace transport_catalogue;
+    const string path = "test_router_file.bin"s;
+    TransportCatalogue catalogue;
+    FillTestCatalogue(catalogue, 30, 12, 5);
+    transport_router::Router expected;
+    SetTestRouteSettings(expected);
+    expected.FormGraph(catalogue);
+
+    std::remove(path.c_str());
+    transport_router::Router saving;
+    SetTestRouteSettings(saving);
+    saving.SetRoutingCacheFile(path);
+    saving.FormGraph(catalogue);
+    AssertSameStopRoutes(saving, expected, catalogue);
+
+    transport_router::RouterFileHeader header;
+    {
+        ifstream file(path, ios::binary);
+        assert(file.read(reinterpret_cast<char*>(&header), sizeof(header)));
+    }
+    // Wait vertices of the stops with buses are 0, 2, 4... in the order of the stops
+    vector<string_view> served_stops;
+    for(const Stop& stop : catalogue.GetAllStops())
+    {
+        if(!stop.routes_.empty())
+        {
+            served_stops.push_back(stop.stop_name_);
+        }
+    }
+    size_t to_index = 1;
+    while(!expected.BuildRoute(served_stops[0], served_stops[to_index]))
+    {
+        ++to_index;
+    }
+    const string_view from = served_stops[0];
+    const string_view to = served_stops[to_index];
+    const auto route = expected.BuildRoute(from, to);
+    const uint64_t cell = 2 * to_index;
+    auto write_cell = [&path](uint64_t offset, const auto& value) {
+        fstream file(path, ios::binary | ios::in | ios::out);
+        file.seekp(static_cast<streamoff>(offset));
+        file.write(reinterpret_cast<const char*>(&value), sizeof(value));
+    };
+    auto read_prev_edge = [&path, &header, cell]() {
+        uint32_t prev_edge = 0;
+        ifstream file(path, ios::binary);
+        file.seekg(static_cast<streamoff>(header.prev_edges_offset + cell * sizeof(uint32_t)));
+        file.read(reinterpret_cast<char*>(&prev_edge), sizeof(prev_edge));
+        return prev_edge;
+    };
+    const uint32_t saved_prev_edge = read_prev_edge();
+    {
+        // A file that passes the checks is served as is: a changed weight shows in the route
+        write_cell(header.weights_offset + cell * sizeof(double), route->total_weight_ + 1.0);
+        transport_router::Router loading;
+        SetTestRouteSettings(loading);
+        loading.SetRoutingCacheFile(path);
+        loading.FormGraph(catalogue);
+        assert(std::abs(loading.BuildRoute(from, to)->total_weight_ - route->total_weight_ - 1.0) < EPSILON);
+        write_cell(header.weights_offset + cell * sizeof(double), route->total_weight_);
+    }
+    for(const uint32_t prev_edge : {static_cast<uint32_t>(header.edge_count), uint32_t{0}})
+    {
+        // A previous edge out of range or into another column is a damaged file: it is
+        // rebuilt and written anew
+        write_cell(header.prev_edges_offset + cell * sizeof(uint32_t), prev_edge);
+        transport_router::Router loading;
+        SetTestRouteSettings(loading);
+        loading.SetRoutingCacheFile(path);
+        loading.FormGraph(catalogue);
+        AssertSameStopRoutes(loading, expected, catalogue);
+        assert(read_prev_edge() == saved_prev_edge);
+    }
+    {
+        transport_router::Router loading;
+        SetTestRouteSettings(loading);
+        loading.SetRoutingCacheFile(path);
+        loading.FormGraph(catalogue);
+        AssertSameStopRoutes(loading, expected, catalogue);
+    }
+    std::remove(path.c_str());
+}
+
+void TestDirectedWeightedGraph()
+{
+    auto graph = MakeRandomGraph(20, 60, 11);
+    vector<vector<graph::EdgeId>> incident_edges(graph.GetVertexCount());
+    for(graph::VertexId vertex = 0; vertex < graph.GetVertexCount(); ++vertex)
+    {
+        for(const graph::EdgeId edge_id : graph.GetIncidentEdges(vertex))
+        {
+            assert(graph.GetEdge(edge_id).from == vertex);
+            incident_edges[vertex].push_back(edge_id);
+        }
+    }
+    auto assert_same_incident_edges = [&graph, &incident_edges]() {
+        for(graph::VertexId vertex = 0; vertex < graph.GetVertexCount(); ++vertex)
+        {
+            const auto range = graph.GetIncidentEdges(vertex);
+            assert(vector<graph::EdgeId>(range.begin(), range.end()) == incident_edges[vertex]);
+            vector<graph::EdgeId> visited;
+            graph.ForEachIncidentEdge(vertex, [&](graph::EdgeId edge_id, graph::VertexId to, double weight) {
+                assert(graph.GetEdge(edge_id).to == to && graph.GetEdge(edge_id).weight == weight);
+                visited.push_back(edge_id);
+            });
+            assert(visited == incident_edges[vertex]);
+        }
+    };
+    // Frozen rows keep the order of addition, and adding an edge unpacks them back
+    graph.Freeze();
+    assert(graph.IsFrozen());
+    assert_same_incident_edges();
+    incident_edges[3].push_back(graph.AddEdge({3, 4, 1.0}));
+    assert(!graph.IsFrozen());
+    assert_same_incident_edges();
+    graph.Freeze();
+    assert_same_incident_edges();
+}
+
+void TestRouterAddBus()
+{
+    using namespace transport_catalogue;
+    const string path = "test_router_add_bus.bin"s;
+    for(const TableWeight table_weight : {TableWeight::DOUBLE, TableWeight::FLOAT, TableWeight::DECISECONDS})
+    {
+        for(const bool is_file_backed : {false, true})
+        {
+            mt19937 generator(7);
+            TransportCatalogue catalogue;
+            FillTestCatalogue(catalogue, 30, 10, 7);
+            auto make_router = [&](transport_router::Router& router) {
+                SetTestRouteSettings(router);
+                router.SetTableWeight(table_weight);
+                if(is_file_backed)
+                {
+                    router.SetRoutingCacheFile(path);
+                }
+                router.FormGraph(catalogue);
+            };
+            std::remove(path.c_str());
+            transport_router::Router router;
+            make_router(router);
+            if(is_file_backed)
+            {
+                // The second router serves the table mapped from the file the first one saved
+                make_router(router);
+            }
+            auto assert_same_as_rebuilt = [&]() {
+                transport_router::Router rebuilt;
+                SetTestRouteSettings(rebuilt);
+                rebuilt.SetTableWeight(table_weight);
+                rebuilt.FormGraph(catalogue);
+                AssertSameStopRoutes(router, rebuilt, catalogue);
+                vector<string_view> stops;
+                for(const Stop& stop : catalogue.GetAllStops())
+                {
+                    stops.push_back(stop.stop_name_);
+                }
+                const auto times = router.BuildTravelTimeMatrix(stops, stops);
+                const auto expected_times = rebuilt.BuildTravelTimeMatrix(stops, stops);
+                for(size_t i = 0; i < stops.size(); ++i)
+                {
+                    for(size_t j = 0; j < stops.size(); ++j)
+                    {
+                        assert(times[i][j].has_value() == expected_times[i][j].has_value());
+                        assert(!times[i][j] || std::abs(*times[i][j] - *expected_times[i][j]) < EPSILON);
+                    }
+                }
+            };
+
+            // Stops of one bus are in one component, so its table is updated in place
+            const Bus& longest_bus = *max_element(catalogue.GetAllRoutes().begin(), catalogue.GetAllRoutes().end(),
+                                                  [](const Bus& lhs, const Bus& rhs) {
+                                                      return lhs.route_.size() < rhs.route_.size();
+                                                  });
+            vector<string_view> candidates;
+            for(const Stop* stop : longest_bus.route_)
+            {
+                candidates.push_back(stop->stop_name_);
+            }
+            AddTestBus(catalogue, candidates, generator);
+            router.AddBus(catalogue.GetAllRoutes().back().bus_name_);
+            assert_same_as_rebuilt();
+
+            // A bus over any of the served stops may join components
+            candidates.clear();
+            for(const Stop& stop : catalogue.GetAllStops())
+            {
+                if(!stop.routes_.empty())
+                {
+                    candidates.push_back(stop.stop_name_);
+                }
+            }
+            AddTestBus(catalogue, candidates, generator);
+            router.AddBus(catalogue.GetAllRoutes().back().bus_name_);
+            assert_same_as_rebuilt();
+
+            // A stop without buses gets its first one
+            candidates.push_back(catalogue.GetAllStops().back().stop_name_);
+            vector<string_view> route = {candidates.front(), candidates.back()};
+            catalogue.AddRoute("bus"s + to_string(catalogue.GetAllRoutes().size()), route.begin(), route.end(), false);
+            router.AddBus(catalogue.GetAllRoutes().back().bus_name_);
+            assert_same_as_rebuilt();
+
+            if(is_file_backed)
+            {
+                // The file was rewritten with the updated table
+                transport_router::Router loading;
+                make_router(loading);
+                AssertSameStopRoutes(loading, router, catalogue);
+            }
+        }
+    }
+    std::remove(path.c_str());
+}
+
+void TestOverlayRouter()
+{
+    {
+        const size_t vertex_count = 200;
+        const auto graph = MakeRandomGraph(vertex_count, 500, 21);
+        // Small cells give several levels, so queries go through cliques of upper levels
+        // that unpack into the cliques below them
+        const auto partition = make_shared<const graph::OverlayPartition>(graph, vector<size_t>{4, 16, 64});
+        assert(partition->GetLevelCount() >= 2);
+        graph::OverlayRouter<double> router(graph, partition);
+        AssertSameRoutes(router, graph::Router<double>(graph), vertex_count);
+
+        // Same edges with other weights: the partition is reused and only the cliques change
+        mt19937 generator(22);
+        uniform_real_distribution<double> weight_distribution(0.5, 20.0);
+        graph::DirectedWeightedGraph<double> reweighted(vertex_count);
+        for(graph::EdgeId edge_id = 0; edge_id < graph.GetEdgeCount(); ++edge_id)
+        {
+            const auto& edge = graph.GetEdge(edge_id);
+            reweighted.AddEdge({edge.from, edge.to, weight_distribution(generator)});
+        }
+        assert(partition->Matches(reweighted));
+        graph::OverlayRouter<double> reweighted_router(reweighted, partition);
+        const graph::Router<double> expected(reweighted);
+        AssertSameRoutes(reweighted_router, expected, vertex_count);
+        reweighted_router.Customize();
+        AssertSameRoutes(reweighted_router, expected, vertex_count);
+    }
+    {
+        // New wait time and velocity keep the graph topology, so the partition is reused
+        using namespace transport_catalogue;
+        TransportCatalogue catalogue;
+        FillTestCatalogue(catalogue, 40, 14, 23);
+        transport_router::Router router;
+        router.SetRoutingEngine(RoutingEngine::OVERLAY);
+        for(const auto& [wait_time, velocity] : {pair{6, 40.0}, pair{2, 25.0}, pair{15, 60.0}})
+        {
+            router.SetRouteSettings(wait_time, velocity);
+            router.FormGraph(catalogue);
+            transport_router::Router expected;
+            expected.SetRouteSettings(wait_time, velocity);
+            expected.FormGraph(catalogue);
+            AssertSameStopRoutes(router, expected, catalogue);
+        }
+    }
+}
+
+void TestHubLabelRouter()
+{
+    const size_t vertex_count = 80;
+    const auto graph = MakeRandomGraph(vertex_count, 200, 31);
+    const graph::Router<double> expected(graph);
+    const graph::HubLabelRouter<double> router(graph);
+    AssertSameRoutes(router, expected, vertex_count);
+    AssertSameWeights(router, expected, vertex_count);
+
+    // Labels saved to a file and read back give the same routes
+    const string path = "test_hub_labels.bin"s;
+    const uint64_t checksum = 42;
+    transport_router::WriteHubLabelFile(path, checksum, router, graph.GetEdgeCount());
+    vector<graph::VertexId> hub_vertices;
+    graph::HubLabels<double> out_labels;
+    graph::HubLabels<double> in_labels;
+    const bool is_stale_read = transport_router::ReadHubLabelFile(path, checksum + 1, vertex_count, graph.GetEdgeCount(),
+                                                                  hub_vertices, out_labels, in_labels);
+    assert(!is_stale_read);
+    const bool is_read = transport_router::ReadHubLabelFile(path, checksum, vertex_count, graph.GetEdgeCount(), hub_vertices,
+                                                            out_labels, in_labels);
+    assert(is_read);
+    std::remove(path.c_str());
+    AssertSameRoutes(graph::HubLabelRouter<double>(graph, hub_vertices, out_labels, in_labels), expected, vertex_count);
+
+    // Labels that break what the queries rely on are rejected
+    auto assert_rejected = [&graph](vector<graph::VertexId> hubs, graph::HubLabels<double> out, graph::HubLabels<double> in) {
+        bool is_thrown = false;
+        try
+        {
+            graph::HubLabelRouter<double>(graph, move(hubs), move(out), move(in));
+        }
+        catch(const invalid_argument&)
+        {
+            is_thrown = true;
+        }
+        assert(is_thrown);
+    };
+    {
+        auto hubs = hub_vertices;
+        hubs[1] = hubs[0];
+        assert_rejected(hubs, out_labels, in_labels);
+    }
+    {
+        // Swapped hubs of a label with two or more entries
+        auto out = out_labels;
+        size_t vertex = 0;
+        while(out.offsets[vertex + 1] - out.offsets[vertex] < 2)
+        {
+            ++vertex;
+        }
+        swap(out.hubs[out.offsets[vertex]], out.hubs[out.offsets[vertex] + 1]);
+        assert_rejected(hub_vertices, out, in_labels);
+    }
+    {
+        // An entry whose edge does not enter the labeled vertex
+        auto in = in_labels;
+        const auto entry = find_if(in.edges.begin(), in.edges.end(), [](graph::EdgeId edge) {
+            return edge != numeric_limits<graph::EdgeId>::max();
+        });
+        const graph::VertexId to = graph.GetEdge(*entry).to;
+        for(graph::EdgeId edge_id = 0; edge_id < graph.GetEdgeCount(); ++edge_id)
+        {
+            if(graph.GetEdge(edge_id).to != to)
+            {
+                *entry = edge_id;
+                break;
+            }
+        }
+        assert_rejected(hub_vertices, out_labels, in);
+    }
+}
+
+
+void TestMemoryPlacement()
+{
+    const memory::PlacementSettings saved_settings = memory::GetPlacementSettings();
+    for(const auto huge_pages : {memory::HugePages::NONE, memory::HugePages::TRANSPARENT, memory::HugePages::EXPLICIT})
+    {
+        memory::SetPlacementSettings({huge_pages, memory::NumaPolicy::INTERLEAVE});
+        // Without reserved hugetlb pages EXPLICIT falls back to an aligned mapping, either way the block is usable
+        for(const size_t size : {size_t{100}, memory::LARGE_ALLOCATION_SIZE, memory::LARGE_ALLOCATION_SIZE * 3 + 1})
+        {
+            memory::Buffer buffer(size, memory::ANY_NODE);
+            assert(buffer.GetData() && buffer.GetSize() == size);
+            char* data = static_cast<char*>(buffer.GetData());
+            for(size_t i = 0; i < size; ++i)
+            {
+                data[i] = static_cast<char>(i);
+            }
+            assert(data[size - 1] == static_cast<char>(size - 1));
+
+            const memory::Placement placement = memory::GetPlacement(data, size);
+            assert(placement.size_ == size && placement.huge_page_bytes_ <= size);
+            ostringstream report;
+            memory::ReportPlacement(report, "table"sv, data, size);
+            assert(report.str().rfind("memory: table: "s, 0) == 0 && report.str().back() == '\n');
+
+            memory::Buffer moved(move(buffer));
+            assert(!buffer.GetData() && moved.GetData() == data && moved.GetSize() == size);
+        }
+        memory::Buffer bound(memory::LARGE_ALLOCATION_SIZE, 0);
+        static_cast<char*>(bound.GetData())[0] = 1;
+    }
+    assert(memory::GetPlacement(nullptr, 0).huge_page_bytes_ == 0);
+
+    memory::SetPlacementSettings({memory::HugePages::EXPLICIT, memory::NumaPolicy::REPLICATE});
+    ostringstream report;
+    memory::ReportSettings(report);
+    assert(report.str().rfind("memory: huge pages explicit, numa policy replicate, "s, 0) == 0);
+    memory::SetPlacementSettings(saved_settings);
+}
+
+void TestComponentRouter()
+{
+    // Vertex v belongs to component v % 3: a chain keeps each component connected, random
+    // edges inside it give the routes
+    const size_t vertex_count = 60;
+    const size_t component_count = 3;
+    mt19937 generator(17);
+    uniform_int_distribution<graph::VertexId> vertex_distribution(0, static_cast<graph::VertexId>(vertex_count - 1));
+    uniform_real_distribution<double> weight_distribution(1.0, 10.0);
+    auto add_random_edge = [&](bool is_inside_component) {
+        const graph::VertexId from = vertex_distribution(generator);
+        graph::VertexId to = vertex_distribution(generator);
+        while((to % component_count == from % component_count) != is_inside_component)
+        {
+            to = vertex_distribution(generator);
+        }
+        return graph::Edge<double>{from, to, weight_distribution(generator)};
+    };
+    graph::DirectedWeightedGraph<double> graph(vertex_count);
+    for(graph::VertexId vertex = 0; vertex + component_count < vertex_count; ++vertex)
+    {
+        graph.AddEdge({vertex, static_cast<graph::VertexId>(vertex + component_count), weight_distribution(generator)});
+    }
+    for(size_t i = 0; i < 150; ++i)
+    {
+        graph.AddEdge(add_random_edge(true));
+    }
+
+    size_t found_count = 0;
+    const auto components = graph::ComponentRouter<double>::FindComponents(graph, found_count);
+    assert(found_count == component_count);
+    for(graph::VertexId vertex = 0; vertex < vertex_count; ++vertex)
+    {
+        assert(components[vertex] == vertex % component_count);
+    }
+
+    // Routes come back with the edge ids of the whole graph, not of the component graphs
+    graph::ComponentRouter<double> router(graph);
+    assert(router.GetComponentCount() == component_count);
+    AssertSameRoutes(router, graph::Router<double>(graph), vertex_count);
+    AssertSameWeights(router, graph::Router<double>(graph), vertex_count);
+
+    // Edges inside the components are taken in place
+    for(size_t i = 0; i < 5; ++i)
+    {
+        graph.AddEdge(add_random_edge(true));
+    }
+    const bool is_updated = router.AddNewEdges();
+    assert(is_updated);
+    const graph::Router<double> expected(graph);
+    AssertSameRoutes(router, expected, vertex_count);
+    AssertSameWeights(router, expected, vertex_count);
+
+    // An edge between two components leaves the router as it was
+    graph.AddEdge(add_random_edge(true));
+    graph.AddEdge(add_random_edge(false));
+    const bool is_joined_updated = router.AddNewEdges();
+    assert(!is_joined_updated);
+    AssertSameRoutes(router, expected, vertex_count);
+}
+
+namespace
+{
+    // The Dijkstra table has the weights of the Floyd-Warshall one. Previous edges match too, except where
+    // routes tie: there both algorithms have to pick a last edge of a shortest route
+    template <typename StoredWeight>
+    void AssertSameTables(const graph::DirectedWeightedGraph<double>& graph)
+    {
+        const graph::Router<double, StoredWeight> expected(graph, graph::TableAlgorithm::FLOYD_WARSHALL);
+        const graph::Router<double, StoredWeight> router(graph, graph::TableAlgorithm::DIJKSTRA);
+        // Floating point sums depend on the order of the additions, integer units do not
+        auto is_same_weight = [](StoredWeight lhs, StoredWeight rhs) {
+            if constexpr(is_floating_point_v<StoredWeight>)
+            {
+                return lhs == rhs || std::abs(lhs - rhs) < 1E-3;
+            }
+            else
+            {
+                return lhs == rhs;
+            }
+        };
+        const size_t vertex_count = graph.GetVertexCount();
+        const StoredWeight* weights = router.GetWeights();
+        const StoredWeight* expected_weights = expected.GetWeights();
+        const auto* prev_edges = router.GetPrevEdges();
+        const auto* expected_prev_edges = expected.GetPrevEdges();
+        size_t tie_count = 0;
+        for(size_t from = 0; from < vertex_count; ++from)
+        {
+            for(size_t to = 0; to < vertex_count; ++to)
+            {
+                const size_t index = from * vertex_count + to;
+                assert(is_same_weight(weights[index], expected_weights[index]));
+                if(prev_edges[index] == expected_prev_edges[index])
+                {
+                    continue;
+                }
+                ++tie_count;
+                for(const graph::EdgeId edge_id : {graph::EdgeId{prev_edges[index]}, graph::EdgeId{expected_prev_edges[index]}})
+                {
+                    const auto& edge = graph.GetEdge(edge_id);
+                    assert(edge.to == to);
+                    assert(is_same_weight(weights[from * vertex_count + edge.from] + static_cast<StoredWeight>(edge.weight),
+                                          weights[index]));
+                }
+            }
+        }
+        // Real valued weights leave no ties
+        assert((!is_same_v<StoredWeight, double> || tie_count == 0));
+    }
+}
+
+void TestDijkstraRoutingTable()
+{
+    using namespace transport_catalogue;
+    for(unsigned seed = 1; seed <= 3; ++seed)
+    {
+        const auto graph = MakeRandomGraph(80, 240, seed);
+        AssertSameTables<double>(graph);
+        AssertSameTables<float>(graph);
+        AssertSameTables<transport_router::DecisecondWeight>(graph);
+        AssertSameRoutes(graph::ComponentRouter<double>(graph, graph::TableAlgorithm::DIJKSTRA), graph::Router<double>(graph), 80);
+    }
+
+    // The setting of the catalogue router gives the same routes either way
+    TransportCatalogue catalogue;
+    FillTestCatalogue(catalogue, 30, 10, 13);
+    for(const TableWeight table_weight : {TableWeight::DOUBLE, TableWeight::FLOAT, TableWeight::DECISECONDS})
+    {
+        transport_router::Router expected;
+        SetTestRouteSettings(expected);
+        expected.SetTableWeight(table_weight);
+        expected.FormGraph(catalogue);
+        transport_router::Router router;
+        SetTestRouteSettings(router);
+        router.SetTableWeight(table_weight);
+        router.SetTableAlgorithm(TableAlgorithm::DIJKSTRA);
+        router.FormGraph(catalogue);
+        AssertSameStopRoutes(router, expected, catalogue);
+    }
+}
+
+void TestDijkstraRouter()
+{
+    const size_t vertex_count = 60;
+    const auto graph = MakeRandomGraph(vertex_count, 150, 23);
+    const graph::Router<double> expected(graph);
+    // An unbounded cache, and caches of one and two trees that evict on almost every new source
+    for(const size_t max_cached_trees : {size_t{0}, size_t{1}, size_t{2}})
+    {
+        const graph::DijkstraRouter<double> router(graph, max_cached_trees);
+        AssertSameRoutes(router, expected, vertex_count);
+        AssertSameWeights(router, expected, vertex_count);
+        // Sources taken in turns, so that trees are evicted and computed again between the queries
+        for(graph::VertexId to = 0; to < vertex_count; ++to)
+        {
+            for(const graph::VertexId from : {graph::VertexId{3}, graph::VertexId{41}, graph::VertexId{17}})
+            {
+                const auto route = router.BuildRoute(from, to);
+                const auto expected_route = expected.BuildRoute(from, to);
+                assert(route.has_value() == expected_route.has_value());
+                assert(!route || route->edges == expected_route->edges);
+            }
+        }
+    }
+}
+
+void TestAStarRouter()
+{
+    using namespace transport_catalogue;
+    {
+        const size_t vertex_count = 60;
+        const auto graph = MakeRandomGraph(vertex_count, 150, 29);
+        const graph::Router<double> expected(graph);
+        // Half of the exact remaining weight is a consistent potential that still directs the search
+        const graph::AStarRouter<double> router(graph, [&expected](graph::VertexId vertex, graph::VertexId target) {
+            const auto route = expected.BuildRoute(vertex, target);
+            return route ? route->weight / 2 : 0.0;
+        });
+        AssertSameRoutes(router, expected, vertex_count);
+        AssertSameWeights(router, expected, vertex_count);
+        const graph::AStarRouter<double> dijkstra(graph, [](graph::VertexId, graph::VertexId) {
+            return 0.0;
+        });
+        AssertSameRoutes(dijkstra, expected, vertex_count);
+    }
+    {
+        // The road from a to far and on to b is much shorter than the straight lines, so the bus over
+        // it beats the direct one. A potential of the straight line at the bus velocity overestimates
+        // the time from far and makes the search settle b by the direct bus first
+        TransportCatalogue catalogue;
+        for(Stop stop : {Stop{"a"s, {55.60, 37.50}}, Stop{"b"s, {55.60, 37.63}}, Stop{"far"s, {55.80, 37.56}}})
+        {
+            catalogue.AddStop(stop);
+        }
+        catalogue.SetDistance("a"sv, "far"sv, 100);
+        catalogue.SetDistance("far"sv, "b"sv, 100);
+        for(const auto& [bus_name, stop_names] : {pair{"direct"s, vector{"a"s, "b"s}}, pair{"there"s, vector{"a"s, "far"s}},
+                                                  pair{"back"s, vector{"far"s, "b"s}}})
+        {
+            catalogue.AddRoute(bus_name, stop_names.begin(), stop_names.end(), false);
+        }
+        transport_router::Router expected;
+        SetTestRouteSettings(expected);
+        expected.FormGraph(catalogue);
+        transport_router::Router router;
+        SetTestRouteSettings(router);
+        router.SetRoutingEngine(RoutingEngine::A_STAR);
+        router.FormGraph(catalogue);
+        const auto route = router.BuildRoute("a"sv, "b"sv);
+        assert(route && route->items_.size() == 4);
+        AssertSameStopRoutes(router, expected, catalogue);
+    }
+    {
+        TransportCatalogue catalogue;
+        FillTestCatalogue(catalogue, 40, 12, 29);
+        transport_router::Router expected;
+        SetTestRouteSettings(expected);
+        expected.FormGraph(catalogue);
+        transport_router::Router router;
+        SetTestRouteSettings(router);
+        router.SetRoutingEngine(RoutingEngine::A_STAR);
+        router.FormGraph(catalogue);
+        AssertSameStopRoutes(router, expected, catalogue);
+    }
+}
+
+namespace
+{
+    vector<string_view> GetStopNames(const transport_catalogue::TransportCatalogue& catalogue)
+    {
+        vector<string_view> stops;
+        for(const Stop& stop : catalogue.GetAllStops())
+        {
+            stops.push_back(stop.stop_name_);
+        }
+        return stops;
+    }
+
+    // Route times between every pair of stops equal the expected ones and are the sums of the
+    // times of the route items; the routes themselves may differ where two of them tie
+    void AssertSameRouteTimes(const transport_router::Router& router, const transport_router::Router& expected,
+                              const transport_catalogue::TransportCatalogue& catalogue)
+    {
+        for(const string_view from : GetStopNames(catalogue))
+        {
+            for(const string_view to : GetStopNames(catalogue))
+            {
+                const auto route = router.BuildRoute(from, to);
+                const auto expected_route = expected.BuildRoute(from, to);
+                assert(route.has_value() == expected_route.has_value());
+                if(!route)
+                {
+                    continue;
+                }
+                assert(std::abs(route->total_weight_ - expected_route->total_weight_) < EPSILON);
+                double time = 0.0;
+                for(const RouteItem& item : route->items_)
+                {
+                    visit([&time](const auto& route_item) { time += route_item.time_; }, item);
+                }
+                assert(std::abs(time - route->total_weight_) < EPSILON);
+            }
+        }
+    }
+
+    // Every stop is reported once
+    map<string_view, double> GetReachableStops(const transport_router::Router& router, string_view from, double max_time)
+    {
+        map<string_view, double> reachable;
+        bool is_repeated = false;
+        router.ForEachReachableStop(from, max_time, [&reachable, &is_repeated](string_view stop, double time) {
+            is_repeated = !reachable.emplace(stop, time).second || is_repeated;
+        });
+        assert(!is_repeated);
+        return reachable;
+    }
+
+    void AssertSameReachable(const map<string_view, double>& reachable, const map<string_view, double>& expected)
+    {
+        assert(reachable.size() == expected.size());
+        for(const auto& [stop, time] : reachable)
+        {
+            assert(expected.count(stop) && std::abs(time - expected.at(stop)) < EPSILON);
+        }
+    }
+
+    // The travel time matrix of the router has the weights of the expected routes, and the stops
+    // reachable within max_time are the cells of its rows that are at most max_time
+    void AssertSameTravelTimes(const transport_router::Router& router, const transport_router::Router& expected,
+                               const transport_catalogue::TransportCatalogue& catalogue, double max_time)
+    {
+        const vector<string_view> stops = GetStopNames(catalogue);
+        const auto matrix = router.BuildTravelTimeMatrix(stops, stops);
+        for(size_t i = 0; i < stops.size(); ++i)
+        {
+            map<string_view, double> expected_reachable;
+            for(size_t j = 0; j < stops.size(); ++j)
+            {
+                const auto expected_route = expected.BuildRoute(stops[i], stops[j]);
+                assert(matrix[i][j].has_value() == expected_route.has_value());
+                assert(!matrix[i][j] || std::abs(*matrix[i][j] - expected_route->total_weight_) < EPSILON);
+                if(matrix[i][j] && *matrix[i][j] <= max_time)
+                {
+                    expected_reachable[stops[j]] = *matrix[i][j];
+                }
+            }
+            AssertSameReachable(GetReachableStops(router, stops[i], max_time), expected_reachable);
+        }
+    }
+}
+
+void TestRaptorRouter()
+{
+    using namespace transport_catalogue;
+    for(const unsigned seed : {5u, 37u})
+    {
+        TransportCatalogue catalogue;
+        FillTestCatalogue(catalogue, 40, 14, seed);
+        transport_router::Router expected;
+        SetTestRouteSettings(expected);
+        expected.FormGraph(catalogue);
+        transport_router::Router router;
+        SetTestRouteSettings(router);
+        router.SetRoutingEngine(RoutingEngine::RAPTOR);
+        router.FormGraph(catalogue);
+        AssertSameRouteTimes(router, expected, catalogue);
+        AssertSameTravelTimes(router, expected, catalogue, 20.0);
+    }
+}
+
+void TestLinearBusModel()
+{
+    using namespace transport_catalogue;
+    for(const unsigned seed : {3u, 19u})
+    {
+        TransportCatalogue catalogue;
+        FillTestCatalogue(catalogue, 40, 14, seed);
+        transport_router::Router quadratic_router;
+        SetTestRouteSettings(quadratic_router);
+        quadratic_router.FormGraph(catalogue);
+        // The ride of several stops is a chain of edges here, merged back into one item by BuildRoute
+        transport_router::Router linear_router;
+        SetTestRouteSettings(linear_router);
+        linear_router.SetLinearBusModel(true);
+        linear_router.FormGraph(catalogue);
+        AssertSameStopRoutes(linear_router, quadratic_router, catalogue);
+    }
+}
+
+namespace
+{
+    // Two stops with a bus between them and a third one without buses
+    const string TEST_JSON_BASE = R"({
+        "base_requests": [
+            {"type": "Stop", "name": "a", "latitude": 55.60, "longitude": 37.50, "road_distances": {"b": 1000}},
+            {"type": "Stop", "name": "b", "latitude": 55.61, "longitude": 37.51, "road_distances": {"a": 1000}},
+            {"type": "Stop", "name": "c", "latitude": 55.62, "longitude": 37.52, "road_distances": {}},
+            {"type": "Bus", "name": "x", "stops": ["a", "b"], "is_roundtrip": false}
+        ],
+        "render_settings": {
+            "width": 600, "height": 400, "padding": 50, "stop_radius": 5, "line_width": 14,
+            "bus_label_font_size": 20, "bus_label_offset": [7, 15], "stop_label_font_size": 20,
+            "stop_label_offset": [7, -3], "underlayer_color": [255, 255, 255, 0.85], "underlayer_width": 3,
+            "color_palette": ["green"]
+        },)"s;
+
+    // Runs the requests on the base above the way main does and returns the answers
+    json::Array RunTestJsonRequests(string_view routing_engine, string_view stat_requests)
+    {
+        istringstream input(TEST_JSON_BASE + R"("routing_settings": {"bus_wait_time": 6, "bus_velocity": 40, "routing_engine": ")"s
+                            + string(routing_engine) + R"("}, "stat_requests": )"s + string(stat_requests) + "}"s);
+        Handler handler;
+        InputReader json_reader;
+        StatAnswer json_answer;
+        handler.FormCatalogueFromJson(input, &json_reader);
+        handler.FormRequestsFromJson(input, &json_reader);
+        ostringstream output;
+        handler.HandleRequestsJson(output, &json_answer);
+        istringstream answers(output.str());
+        return json::Load(answers).GetRoot().AsArray();
+    }
+}
+
+void TestTravelTimeMatrixJson()
+{
+    // The bus takes 1 km at 40 km/h after a wait of 6 minutes; the stop without buses reaches only itself
+    for(const string_view routing_engine : {"all_pairs"sv, "dijkstra"sv, "a_star"sv, "raptor"sv})
+    {
+        const auto answers = RunTestJsonRequests(routing_engine,
+            R"([{"id": 1, "type": "TravelTimeMatrix", "from": ["a", "c"], "to": ["a", "b", "c"]}])"sv);
+        assert(answers.size() == 1);
+        const auto& answer = answers[0].AsMap();
+        assert(answer.at("request_id"s).AsInt() == 1);
+        const auto& times = answer.at("times"s).AsArray();
+        assert(times.size() == 2);
+        const auto& from_a = times[0].AsArray();
+        const auto& from_c = times[1].AsArray();
+        assert(from_a.size() == 3 && from_c.size() == 3);
+        assert(std::abs(from_a[0].AsDouble()) < EPSILON && std::abs(from_a[1].AsDouble() - 7.5) < EPSILON && from_a[2].IsNull());
+        assert(from_c[0].IsNull() && from_c[1].IsNull() && std::abs(from_c[2].AsDouble()) < EPSILON);
+    }
+}
+
+void TestLruCache()
+{
+    using namespace transport_catalogue;
+    {
+        transport_router::LruCache<int, int> cache(2);
+        cache.Put(1, 10);
+        cache.Put(2, 20);
+        // The lookup makes 1 the most recent entry, so 2 goes first
+        assert(cache.Get(1) == 10);
+        cache.Put(3, 30);
+        assert(!cache.Get(2));
+        assert(cache.Get(1) == 10 && cache.Get(3) == 30);
+        // Put of a present key replaces the value and refreshes the entry
+        cache.Put(1, 11);
+        cache.Put(4, 40);
+        assert(!cache.Get(3) && cache.Get(1) == 11);
+        assert(cache.GetHitCount() == 4 && cache.GetMissCount() == 2);
+
+        cache.SetCapacity(1);
+        assert(cache.Get(1) == 11 && !cache.Get(4));
+        cache.Clear();
+        assert(cache.GetHitCount() == 0 && cache.GetMissCount() == 0);
+        assert(!cache.Get(1));
+    }
+    {
+        transport_router::LruCache<int, int> cache;
+        cache.Put(1, 10);
+        assert(!cache.Get(1));
+        assert(cache.GetHitCount() == 0 && cache.GetMissCount() == 1);
+    }
+    {
+        // The routes cached by the router are dropped whenever the graph changes
+        mt19937 generator(41);
+        TransportCatalogue catalogue;
+        FillTestCatalogue(catalogue, 30, 10, 41);
+        transport_router::Router router;
+        SetTestRouteSettings(router);
+        router.SetRouteCacheSize(8);
+        router.FormGraph(catalogue);
+        const string_view from = catalogue.GetAllRoutes().front().route_.front()->stop_name_;
+        const string_view to = catalogue.GetAllRoutes().front().route_.back()->stop_name_;
+        const auto route = router.GetRoute(from, to);
+        assert(route && router.GetRoute(from, to) == route);
+        assert(router.GetRouteCacheStats().hit_count_ == 1 && router.GetRouteCacheStats().miss_count_ == 1);
+
+        router.FormGraph(catalogue);
+        assert(router.GetRouteCacheStats().hit_count_ == 0 && router.GetRouteCacheStats().miss_count_ == 0);
+        assert(router.GetRoute(from, to) != route);
+        router.GetRoute(from, to);
+        assert(router.GetRouteCacheStats().hit_count_ == 1 && router.GetRouteCacheStats().miss_count_ == 1);
+
+        vector<string_view> candidates = GetStopNames(catalogue);
+        candidates.resize(candidates.size() - 2);
+        AddTestBus(catalogue, candidates, generator);
+        router.AddBus(catalogue.GetAllRoutes().back().bus_name_);
+        assert(router.GetRouteCacheStats().hit_count_ == 0 && router.GetRouteCacheStats().miss_count_ == 0);
+        router.GetRoute(from, to);
+        assert(router.GetRouteCacheStats().hit_count_ == 0 && router.GetRouteCacheStats().miss_count_ == 1);
+    }
+}
+
+void TestIsochrone()
+{
+    using namespace transport_catalogue;
+    {
+        // The scan of a table row gives the vertices of the search bounded by the budget
+        const size_t vertex_count = 60;
+        const auto graph = MakeRandomGraph(vertex_count, 150, 43);
+        const graph::Router<double> table(graph);
+        for(graph::VertexId from = 0; from < vertex_count; ++from)
+        {
+            for(const double max_weight : {0.0, 5.0, 15.0})
+            {
+                map<graph::VertexId, double> reachable;
+                const bool is_table_read = table.ForEachReachable(from, max_weight, [&reachable](graph::VertexId vertex, double weight) {
+                    reachable.emplace(vertex, weight);
+                });
+                assert(is_table_read);
+                map<graph::VertexId, double> expected;
+                graph::ForEachVertexWithinWeight(graph, from, max_weight, [&expected](graph::VertexId vertex, double weight) {
+                    expected.emplace(vertex, weight);
+                });
+                assert(reachable.size() == expected.size());
+                for(const auto& [vertex, weight] : reachable)
+                {
+                    assert(expected.count(vertex) && std::abs(weight - expected.at(vertex)) < EPSILON);
+                }
+            }
+        }
+    }
+
+    TransportCatalogue catalogue;
+    FillTestCatalogue(catalogue, 40, 14, 43);
+    const vector<string_view> stops = GetStopNames(catalogue);
+    transport_router::Router expected;
+    SetTestRouteSettings(expected);
+    expected.FormGraph(catalogue);
+    transport_router::Router dijkstra;
+    SetTestRouteSettings(dijkstra);
+    dijkstra.SetRoutingEngine(RoutingEngine::DIJKSTRA);
+    dijkstra.FormGraph(catalogue);
+    for(const RoutingEngine engine : {RoutingEngine::ALL_PAIRS, RoutingEngine::DIJKSTRA, RoutingEngine::CONTRACTION_HIERARCHIES,
+                                      RoutingEngine::A_STAR, RoutingEngine::OVERLAY, RoutingEngine::HUB_LABELS,
+                                      RoutingEngine::RAPTOR})
+    {
+        transport_router::Router router;
+        SetTestRouteSettings(router);
+        router.SetRoutingEngine(engine);
+        router.FormGraph(catalogue);
+        AssertSameTravelTimes(router, expected, catalogue, 20.0);
+        for(const string_view stop : stops)
+        {
+            // No time leaves only the start stop
+            AssertSameReachable(GetReachableStops(router, stop, 0.0), {{stop, 0.0}});
+            // The all-pairs table is read, the Dijkstra engine searches up to the budget
+            AssertSameReachable(GetReachableStops(router, stop, 20.0), GetReachableStops(dijkstra, stop, 20.0));
+        }
+        // The last stop has no buses and reaches only itself
+        AssertSameReachable(GetReachableStops(router, stops.back(), 1000.0), {{stops.back(), 0.0}});
+    }
+
+    for(const string_view routing_engine : {"all_pairs"sv, "dijkstra"sv, "raptor"sv})
+    {
+        const auto answers = RunTestJsonRequests(routing_engine, R"([
+            {"id": 1, "type": "Isochrone", "from": "a", "max_time": 10},
+            {"id": 2, "type": "Isochrone", "from": "a", "max_time": 0},
+            {"id": 3, "type": "Isochrone", "from": "c", "max_time": 100}
+        ])"sv);
+        assert(answers.size() == 3);
+        auto assert_stops = [&answers](size_t index, const vector<pair<string, double>>& expected_stops) {
+            const auto& answer = answers[index].AsMap();
+            assert(answer.at("request_id"s).AsInt() == static_cast<int>(index + 1));
+            const auto& answer_stops = answer.at("stops"s).AsArray();
+            assert(answer_stops.size() == expected_stops.size());
+            for(size_t i = 0; i < answer_stops.size(); ++i)
+            {
+                assert(answer_stops[i].AsMap().at("stop_name"s).AsString() == expected_stops[i].first);
+                assert(std::abs(answer_stops[i].AsMap().at("time"s).AsDouble() - expected_stops[i].second) < EPSILON);
+            }
+        };
+        // Sorted by the time
+        assert_stops(0, {{"a"s, 0.0}, {"b"s, 7.5}});
+        assert_stops(1, {{"a"s, 0.0}});
+        assert_stops(2, {{"c"s, 0.0}});
+    }
+}
+
+void RunAllTests()
+{
+    TestTransportCatalogue();
+    TestContractionHierarchyRouter();
+    TestParallelForEachIndex();
+    TestRouterFile();
+    TestDirectedWeightedGraph();
+    TestRouterAddBus();
+    TestOverlayRouter();
+    TestHubLabelRouter();
+    TestMemoryPlacement();
+    TestComponentRouter();
+    TestDijkstraRoutingTable();
+    TestDijkstraRouter();
+    TestAStarRouter();
+    TestRaptorRouter();
+    TestLinearBusModel();
+    TestTravelTimeMatrixJson();
+    TestLruCache();
+    TestIsochrone();
 }
\ No newline at end of file
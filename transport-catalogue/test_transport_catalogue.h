@@ -1,4 +1,24 @@
 #pragma once
 
 
+// Runs every test below; the checks are asserts, so the build must not define NDEBUG
+void RunAllTests();
+
 void TestTransportCatalogue();
+void TestContractionHierarchyRouter();
+void TestParallelForEachIndex();
+void TestRouterFile();
+void TestDirectedWeightedGraph();
+void TestRouterAddBus();
+void TestOverlayRouter();
+void TestHubLabelRouter();
+void TestMemoryPlacement();
+void TestComponentRouter();
+void TestDijkstraRoutingTable();
+void TestDijkstraRouter();
+void TestAStarRouter();
+void TestRaptorRouter();
+void TestLinearBusModel();
+void TestTravelTimeMatrixJson();
+void TestLruCache();
+void TestIsochrone();
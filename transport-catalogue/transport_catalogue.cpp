@@ -9,6 +9,7 @@ namespace transport_catalogue{
         {
             return *stop;
         }
+        bus_stop.id_ = static_cast<StopId>(stops_.size());
         stops_.push_back(std::move(bus_stop));
         stopname_to_stop_.insert({stops_.back().stop_name_, stops_.back()});
         return stops_.back();
@@ -31,6 +32,13 @@ namespace transport_catalogue{
         {
             return *bus;
         }
+        bus_route.id_ = static_cast<BusId>(buses_.size());
+        bus_route.stop_ids_.clear();
+        for(const Stop* stop : bus_route.route_)
+        {
+            bus_route.stop_ids_.push_back(stop->id_);
+        }
+        ComputeCumulativeDistances(bus_route);
         buses_.push_back(std::move(bus_route));
         busname_to_bus_.insert({buses_.back().bus_name_, buses_.back()});
         for(auto &stop : buses_.back().route_)
@@ -58,17 +66,39 @@ namespace transport_catalogue{
             auto it_end_stop = stopname_to_stop_.find(end_stop);
             if(it_end_stop != stopname_to_stop_.end())
             {
-                map_.AddNode(it_start_stop->first, it_end_stop->first, {distance});
+                map_.AddNode(it_start_stop->second.id_, it_end_stop->second.id_, {distance});
+                // Buses added earlier may ride between these stops
+                for(const Stop* stop : {&it_start_stop->second, &it_end_stop->second})
+                {
+                    for(const auto bus_name : stop->routes_)
+                    {
+                        ComputeCumulativeDistances(busname_to_bus_.at(bus_name));
+                    }
+                }
             }
         }
     }
 
+    void TransportCatalogue::ComputeCumulativeDistances(Bus& bus) const
+    {
+        bus.cumulative_distances_.assign(bus.stop_ids_.size(), 0.0);
+        for(size_t i = 1; i < bus.stop_ids_.size(); ++i)
+        {
+            bus.cumulative_distances_[i] = bus.cumulative_distances_[i-1] + GetDistance(bus.stop_ids_[i-1], bus.stop_ids_[i]);
+        }
+    }
+
     double TransportCatalogue::GetDistance(std::string_view start_stop, std::string_view end_stop) const
+    {
+        return GetDistance(stopname_to_stop_.at(start_stop).id_, stopname_to_stop_.at(end_stop).id_);
+    }
+
+    double TransportCatalogue::GetDistance(StopId start_stop, StopId end_stop) const
     {
         std::optional<double> dis = map_.GetDistance(start_stop, end_stop);
         if(!dis.has_value())
         {
-            return ComputeDistance(stopname_to_stop_.at(start_stop).stop_coordinates_, stopname_to_stop_.at(end_stop).stop_coordinates_);
+            return ComputeDistance(stops_[start_stop].stop_coordinates_, stops_[end_stop].stop_coordinates_);
         }
         return dis.value();
     }
@@ -94,16 +124,12 @@ namespace transport_catalogue{
                 return std::optional{info};
             }
             info.number_of_stops_ = route->route_.size();
-            std::unordered_map<Stop*, size_t, StopHasher, StopEqual> unique_elements;
-            for(const auto el : route->route_)
-            {
-                unique_elements[el] += 1;
-            }
+            std::unordered_set<StopId> unique_elements(route->stop_ids_.begin(), route->stop_ids_.end());
             info.number_of_uniq_stops_ = unique_elements.size();
+            info.route_length_ = route->cumulative_distances_.back();
             double geo_distance = 0.0;
             for(size_t i = 1; i < route->route_.size(); ++i)
             {
-                info.route_length_ += GetDistance(route->route_[i-1]->stop_name_, route->route_[i]->stop_name_);
                 geo_distance += ComputeDistance(route->route_[i-1]->stop_coordinates_, route->route_[i]->stop_coordinates_);
             }
             info.curvature = info.route_length_ / geo_distance;
@@ -130,26 +156,27 @@ namespace transport_catalogue{
 
     }
 
-    void TransportCatalogueMap::AddNode(std::string_view start_stop, std::string_view end_stop, TypeOfConnection node)
+    namespace
     {
-        adjacency_matrix_[start_stop][end_stop] = node;
-        auto it = adjacency_matrix_.find(end_stop);
-        if(it == adjacency_matrix_.end() || it->second.find(start_stop) == it->second.end())
+        uint64_t MakeStopPairKey(StopId start_stop, StopId end_stop)
         {
-            adjacency_matrix_[end_stop][start_stop] = node;
+            return (static_cast<uint64_t>(start_stop) << 32) | end_stop;
         }
     }
 
-    std::optional<double> TransportCatalogueMap::GetDistance(std::string_view start_stop, std::string_view end_stop) const
+    void TransportCatalogueMap::AddNode(StopId start_stop, StopId end_stop, TypeOfConnection node)
+    {
+        adjacency_matrix_[MakeStopPairKey(start_stop, end_stop)] = node;
+        // The reverse direction defaults to the same distance unless it is set explicitly
+        adjacency_matrix_.insert({MakeStopPairKey(end_stop, start_stop), node});
+    }
+
+    std::optional<double> TransportCatalogueMap::GetDistance(StopId start_stop, StopId end_stop) const
     {
-        auto it_start = adjacency_matrix_.find(start_stop);
-        if(it_start != adjacency_matrix_.end())
+        auto it = adjacency_matrix_.find(MakeStopPairKey(start_stop, end_stop));
+        if(it != adjacency_matrix_.end())
         {
-            auto it_stop = it_start->second.find(end_stop);
-            if(it_stop != it_start->second.end())
-            {
-                return std::optional{it_stop->second.distance};
-            }
+            return std::optional{it->second.distance};
         }
         return std::nullopt;
     }
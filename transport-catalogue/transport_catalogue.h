@@ -22,10 +22,11 @@ namespace transport_catalogue{
 			double distance = 0;
 		};
 
-		void AddNode(std::string_view start_stop, std::string_view end_stop, TypeOfConnection node);
-		std::optional<double> GetDistance(std::string_view start_stop, std::string_view end_stop) const;
+		void AddNode(StopId start_stop, StopId end_stop, TypeOfConnection node);
+		std::optional<double> GetDistance(StopId start_stop, StopId end_stop) const;
 		private:
-		std::unordered_map<std::string_view, std::unordered_map<std::string_view, TypeOfConnection>> adjacency_matrix_;
+		// Keyed by (start_stop << 32 | end_stop)
+		std::unordered_map<uint64_t, TypeOfConnection> adjacency_matrix_;
 	};
 
 	class TransportCatalogue {
@@ -38,12 +39,16 @@ namespace transport_catalogue{
 		const Bus* SearchRoute(std::string_view route_name) const;
 		void SetDistance(std::string_view start_stop, std::string_view end_stop, double distance);
 		double GetDistance(std::string_view start_stop, std::string_view end_stop) const;
+		// Road distance, or the straight-line one if it is not set
+		double GetDistance(StopId start_stop, StopId end_stop) const;
 		std::optional<RouteInfo> GetInfoAboutRoute(std::string_view route_name) const;
 		std::optional<StopInfo> GetInfoAboutBusesViaStop(std::string_view stop_name) const;
 		const std::deque<Bus>& GetAllRoutes() const;
 		const std::deque<Stop>& GetAllStops() const;
 		
 		private:
+		void ComputeCumulativeDistances(Bus& bus) const;
+
 		std::deque<Stop> stops_;
 		std::unordered_map<std::string_view, Stop&> stopname_to_stop_;
 		std::deque<Bus> buses_;
@@ -1,24 +1,467 @@
 #include "transport_router.h"
+#include "parallel.h"
+
+#include <cmath>
+#include <iomanip>
+#include <limits>
+#include <stdexcept>
+#include <string>
 
 namespace transport_router
 {
     using namespace transport_catalogue;
 
+    namespace
+    {
+        template <typename StoredWeight>
+        void ReportRoutingTable(std::ostream& out, const std::string& name, const graph::Router<double, StoredWeight>& table)
+        {
+            const size_t cell_count = table.GetTableSize() / (sizeof(StoredWeight) + sizeof(graph::CompactEdgeId));
+            memory::ReportPlacement(out, name + " weights", table.GetWeights(), cell_count * sizeof(StoredWeight));
+            memory::ReportPlacement(out, name + " previous edges", table.GetPrevEdges(), cell_count * sizeof(graph::CompactEdgeId));
+            for(size_t node = 0; node < table.GetReplicaCount(); ++node)
+            {
+                const std::string replica = " on node " + std::to_string(node);
+                memory::ReportPlacement(out, name + " weights" + replica, table.GetReplicaWeights(node),
+                                        cell_count * sizeof(StoredWeight));
+                memory::ReportPlacement(out, name + " previous edges" + replica, table.GetReplicaPrevEdges(node),
+                                        cell_count * sizeof(graph::CompactEdgeId));
+            }
+        }
+    }
+
     void Router::SetRouteSettings(int wait_time, double bus_velocity) {
         route_settings_.bus_velocity_ = bus_velocity;
         route_settings_.bus_wait_time_ = wait_time;
     }
 
+    void Router::SetRoutingEngine(RoutingEngine engine) {
+        route_settings_.routing_engine_ = engine;
+    }
+
+    void Router::SetLinearBusModel(bool is_linear) {
+        route_settings_.linear_bus_model_ = is_linear;
+    }
+
+    void Router::SetCompactRoutingTable(bool is_compact) {
+        route_settings_.table_weight_ = is_compact ? TableWeight::FLOAT : TableWeight::DOUBLE;
+    }
+
+    void Router::SetTableWeight(TableWeight table_weight) {
+        route_settings_.table_weight_ = table_weight;
+    }
+
+    void Router::SetTableAlgorithm(TableAlgorithm table_algorithm) {
+        route_settings_.table_algorithm_ = table_algorithm;
+    }
+
+    void Router::SetRoutingCacheFile(std::string path) {
+        route_settings_.routing_cache_file_ = std::move(path);
+    }
+
+    void Router::SetRouteCacheSize(size_t size) {
+        route_settings_.route_cache_size_ = size;
+        route_cache_.SetCapacity(size);
+    }
+
+    void Router::SetDijkstraCachedTrees(size_t count) {
+        route_settings_.dijkstra_cached_trees_ = count;
+    }
+
+    void Router::SetMemoryPlacement(const memory::PlacementSettings& settings) {
+        route_settings_.memory_placement_ = settings;
+    }
+
+    void Router::SetMemoryReport(bool is_enabled) {
+        route_settings_.memory_report_ = is_enabled;
+    }
+
     const RouteSettings& Router::GetRouteSettings() const {
         return route_settings_;
     }
 
     void Router::FormGraph(const TransportCatalogue &transp_catalogue) {
         transp_catalogue_ = &transp_catalogue;
-        graph_ = std::make_unique<graph::DirectedWeightedGraph<double>>(graph::DirectedWeightedGraph<double>(transp_catalogue.GetAllStops().size() * 2));
+        memory::SetPlacementSettings(route_settings_.memory_placement_);
+        router_.reset();
+        router_file_.reset();
+        raptor_router_.reset();
+        graph_.reset();
+        edge_infos_.clear();
+        riding_vertex_stops_.clear();
+        vertex_id_ = 0;
+        route_cache_.Clear();
+        if(route_settings_.routing_engine_ == RoutingEngine::RAPTOR)
+        {
+            raptor_router_ = std::make_unique<RaptorRouter>(transp_catalogue, route_settings_);
+            return;
+        }
+        SetServedStops();
+        const bool use_cache_file = route_settings_.routing_engine_ == RoutingEngine::ALL_PAIRS
+                                    && !route_settings_.routing_cache_file_.empty();
+        const uint64_t checksum = use_cache_file ? ComputeChecksum() : 0;
+        if(use_cache_file && LoadFromFile(checksum))
+        {
+            return;
+        }
+        graph_ = std::make_unique<graph::DirectedWeightedGraph<double>>(CountVertices());
         SetAllStops();
         SetAllBuses();
-        router_ = std::make_unique<graph::Router<double>>(*graph_.get());
+        graph_->Freeze();
+        FormRouter(use_cache_file, checksum);
+    }
+
+    void Router::AddBus(std::string_view bus_name)
+    {
+        const Bus* bus = transp_catalogue_->SearchRoute(bus_name);
+        if(!bus)
+        {
+            throw std::invalid_argument("Unknown bus: " + std::string(bus_name));
+        }
+        // Stops added to the catalogue since FormGraph have no buses but this one
+        stop_vertices_.resize(transp_catalogue_->GetAllStops().size(), NO_VERTEX);
+        bool has_new_stops = false;
+        for(const StopId stop : bus->stop_ids_)
+        {
+            has_new_stops = has_new_stops || !IsServed(stop);
+        }
+        // Riding vertices of the linear bus model and newly served stops extend the vertex set
+        if(!graph_ || route_settings_.linear_bus_model_ || has_new_stops)
+        {
+            FormGraph(*transp_catalogue_);
+            return;
+        }
+        route_cache_.Clear();
+        SetBus(*bus);
+        graph_->Freeze();
+
+        const bool use_cache_file = route_settings_.routing_engine_ == RoutingEngine::ALL_PAIRS
+                                    && !route_settings_.routing_cache_file_.empty();
+        if(route_settings_.routing_engine_ == RoutingEngine::ALL_PAIRS)
+        {
+            bool is_updated = false;
+            switch(route_settings_.table_weight_)
+            {
+                case TableWeight::FLOAT:
+                    is_updated = UpdateAllPairsRouter<float>();
+                    break;
+                case TableWeight::DECISECONDS:
+                    is_updated = UpdateAllPairsRouter<DecisecondWeight>();
+                    break;
+                default:
+                    is_updated = UpdateAllPairsRouter<double>();
+                    break;
+            }
+            if(is_updated)
+            {
+                return;
+            }
+        }
+        router_.reset();
+        router_file_.reset();
+        FormRouter(use_cache_file, use_cache_file ? ComputeChecksum() : 0);
+    }
+
+    template <typename StoredWeight>
+    bool Router::UpdateAllPairsRouter()
+    {
+        if(auto* router = dynamic_cast<graph::ComponentRouter<double, StoredWeight>*>(router_.get()))
+        {
+            return router->AddNewEdges();
+        }
+        auto* router = dynamic_cast<graph::Router<double, StoredWeight>*>(router_.get());
+        if(!router)
+        {
+            return false;
+        }
+        router->AddNewEdges();
+        // The table is copied out of the mapping by the update
+        router_file_.reset();
+        if(!route_settings_.routing_cache_file_.empty())
+        {
+            SaveToFile(ComputeChecksum(), router->GetWeights(), sizeof(StoredWeight), router->GetPrevEdges());
+        }
+        return true;
+    }
+
+    void Router::FormRouter(bool use_cache_file, uint64_t checksum)
+    {
+        switch(route_settings_.routing_engine_)
+        {
+            case RoutingEngine::DIJKSTRA:
+                router_ = std::make_unique<graph::DijkstraRouter<double>>(*graph_.get(), route_settings_.dijkstra_cached_trees_);
+                break;
+            case RoutingEngine::CONTRACTION_HIERARCHIES:
+                router_ = std::make_unique<graph::ContractionHierarchyRouter<double>>(*graph_.get());
+                break;
+            case RoutingEngine::A_STAR:
+                router_ = std::make_unique<graph::AStarRouter<double>>(*graph_.get(), MakeGeoPotential());
+                break;
+            case RoutingEngine::OVERLAY:
+                if(!overlay_partition_ || !overlay_partition_->Matches(*graph_))
+                {
+                    overlay_partition_ = std::make_shared<graph::OverlayPartition>(*graph_);
+                }
+                router_ = std::make_unique<graph::OverlayRouter<double>>(*graph_.get(), overlay_partition_);
+                break;
+            case RoutingEngine::HUB_LABELS:
+                FormHubLabelRouter();
+                break;
+            default:
+                switch(route_settings_.table_weight_)
+                {
+                    case TableWeight::FLOAT:
+                        FormAllPairsRouter<float>(use_cache_file, checksum);
+                        break;
+                    case TableWeight::DECISECONDS:
+                        FormAllPairsRouter<DecisecondWeight>(use_cache_file, checksum);
+                        break;
+                    default:
+                        FormAllPairsRouter<double>(use_cache_file, checksum);
+                        break;
+                }
+                break;
+        }
+    }
+
+    template <typename StoredWeight>
+    void Router::FormAllPairsRouter(bool save_to_file, uint64_t checksum) {
+        // The cache file keeps a single table, otherwise every connected component of the
+        // graph gets a table of its own
+        const graph::TableAlgorithm algorithm = route_settings_.table_algorithm_ == TableAlgorithm::DIJKSTRA
+                                                ? graph::TableAlgorithm::DIJKSTRA
+                                                : graph::TableAlgorithm::FLOYD_WARSHALL;
+        if(!save_to_file)
+        {
+            router_ = std::make_unique<graph::ComponentRouter<double, StoredWeight>>(*graph_.get(), algorithm);
+            return;
+        }
+        auto router = std::make_unique<graph::Router<double, StoredWeight>>(*graph_.get(), algorithm);
+        SaveToFile(checksum, router->GetWeights(), sizeof(StoredWeight), router->GetPrevEdges());
+        router_ = std::move(router);
+    }
+
+    void Router::FormHubLabelRouter()
+    {
+        const std::string& path = route_settings_.routing_cache_file_;
+        const uint64_t checksum = path.empty() ? 0 : ComputeChecksum();
+        if(!path.empty())
+        {
+            std::vector<graph::VertexId> hub_vertices;
+            graph::HubLabels<double> out_labels;
+            graph::HubLabels<double> in_labels;
+            if(ReadHubLabelFile(path, checksum, graph_->GetVertexCount(), graph_->GetEdgeCount(), hub_vertices, out_labels, in_labels))
+            {
+                try
+                {
+                    router_ = std::make_unique<graph::HubLabelRouter<double>>(*graph_.get(), std::move(hub_vertices),
+                                                                              std::move(out_labels), std::move(in_labels));
+                    return;
+                }
+                catch(const std::invalid_argument&)
+                {
+                    // Damaged labels are built and saved anew
+                }
+            }
+        }
+        auto router = std::make_unique<graph::HubLabelRouter<double>>(*graph_.get());
+        if(!path.empty())
+        {
+            WriteHubLabelFile(path, checksum, *router, graph_->GetEdgeCount());
+        }
+        router_ = std::move(router);
+    }
+
+    void Router::ReportMemoryPlacement(std::ostream& out) const
+    {
+        memory::ReportSettings(out);
+        if(graph_ && graph_->GetEdgeCount() > 0)
+        {
+            memory::ReportPlacement(out, "graph edges", &graph_->GetEdge(0), graph_->GetEdgeCount() * sizeof(graph::Edge<double>));
+            if(graph_->IsFrozen())
+            {
+                memory::ReportPlacement(out, "graph edge records", &*graph_->GetIncidentEdgeRecords(0).begin(),
+                                        graph_->GetEdgeCount() * sizeof(graph::IncidentEdge<double>));
+            }
+        }
+        switch(route_settings_.table_weight_)
+        {
+            case TableWeight::FLOAT:
+                ReportTablePlacement<float>(out);
+                break;
+            case TableWeight::DECISECONDS:
+                ReportTablePlacement<DecisecondWeight>(out);
+                break;
+            default:
+                ReportTablePlacement<double>(out);
+                break;
+        }
+    }
+
+    template <typename StoredWeight>
+    void Router::ReportTablePlacement(std::ostream& out) const
+    {
+        if(const auto* router = dynamic_cast<const graph::ComponentRouter<double, StoredWeight>*>(router_.get()))
+        {
+            const size_t component_count = router->GetComponentCount();
+            out << "memory: routing tables of " << component_count << (component_count == 1 ? " component: " : " components: ")
+                << std::fixed << std::setprecision(1) << router->GetTableSize() / (1024.0 * 1024.0) << " MiB\n" << std::defaultfloat
+                << std::setprecision(6);
+            // Tables of small components live in the common heap, only the mapped ones are shown
+            for(size_t component = 0; component < router->GetComponentCount(); ++component)
+            {
+                const auto& table = router->GetComponentTable(component);
+                if(table.GetTableSize() >= memory::LARGE_ALLOCATION_SIZE)
+                {
+                    ReportRoutingTable(out, "routing table of component " + std::to_string(component), table);
+                }
+            }
+        }
+        else if(const auto* router = dynamic_cast<const graph::Router<double, StoredWeight>*>(router_.get()))
+        {
+            ReportRoutingTable(out, "routing table", *router);
+        }
+    }
+
+    uint64_t Router::ComputeChecksum() const {
+        // FNV-1a
+        uint64_t checksum = 14695981039346656037ULL;
+        auto add_bytes = [&checksum](const void* data, size_t size) {
+            const auto* bytes = static_cast<const unsigned char*>(data);
+            for(size_t i = 0; i < size; ++i)
+            {
+                checksum = (checksum ^ bytes[i]) * 1099511628211ULL;
+            }
+        };
+        auto add_string = [&add_bytes](std::string_view str) {
+            const uint64_t size = str.size();
+            add_bytes(&size, sizeof(size));
+            add_bytes(str.data(), str.size());
+        };
+
+        add_bytes(&route_settings_.bus_wait_time_, sizeof(route_settings_.bus_wait_time_));
+        add_bytes(&route_settings_.bus_velocity_, sizeof(route_settings_.bus_velocity_));
+        add_bytes(&route_settings_.linear_bus_model_, sizeof(route_settings_.linear_bus_model_));
+        const uint64_t stop_count = transp_catalogue_->GetAllStops().size();
+        add_bytes(&stop_count, sizeof(stop_count));
+        for(const auto& stop : transp_catalogue_->GetAllStops())
+        {
+            add_string(stop.stop_name_);
+        }
+        const uint64_t bus_count = transp_catalogue_->GetAllRoutes().size();
+        add_bytes(&bus_count, sizeof(bus_count));
+        for(const auto& bus : transp_catalogue_->GetAllRoutes())
+        {
+            add_string(bus.bus_name_);
+            const uint64_t route_size = bus.route_.size();
+            add_bytes(&route_size, sizeof(route_size));
+            for(size_t i = 0; i < bus.route_.size(); ++i)
+            {
+                add_string(bus.route_.at(i)->stop_name_);
+                add_bytes(&bus.cumulative_distances_[i], sizeof(double));
+            }
+        }
+        return checksum;
+    }
+
+    bool Router::LoadFromFile(uint64_t checksum) {
+        using namespace graph;
+        auto file = std::make_unique<MappedRouterFile>(route_settings_.routing_cache_file_);
+        const auto& stops = transp_catalogue_->GetAllStops();
+        const auto& buses = transp_catalogue_->GetAllRoutes();
+        if(!file->IsValid() || file->GetHeader().checksum != checksum
+            || file->GetHeader().weight_type != static_cast<RouterFileWeightType>(route_settings_.table_weight_)
+            || file->GetHeader().vertex_count != CountVertices())
+        {
+            return false;
+        }
+
+        // The checksum covers what the file was built from and not its contents, so a
+        // damaged file is caught here and rebuilt
+        const RouterFileEdge* edges = file->GetEdges();
+        const size_t edge_count = file->GetHeader().edge_count;
+        const size_t vertex_count = CountVertices();
+        for(size_t i = 0; i < edge_count; ++i)
+        {
+            const RouterFileEdge& edge = edges[i];
+            const size_t owner_count = edge.kind == RouterFileEdgeKind::WAIT ? stops.size() : buses.size();
+            if(edge.kind > RouterFileEdgeKind::ALIGHT || (edge.kind != RouterFileEdgeKind::ALIGHT && edge.owner_index >= owner_count)
+                || edge.from >= vertex_count || edge.to >= vertex_count || !(edge.weight >= 0.0))
+            {
+                return false;
+            }
+        }
+
+        graph_ = std::make_unique<DirectedWeightedGraph<double>>(vertex_count);
+        vertex_id_ = served_stops_.size() * 2;
+        if(route_settings_.linear_bus_model_)
+        {
+            for(const auto& bus : buses)
+            {
+                AddRidingVertices(bus);
+            }
+        }
+        edge_infos_.reserve(edge_count);
+        for(size_t i = 0; i < edge_count; ++i)
+        {
+            const RouterFileEdge& edge = edges[i];
+            // EdgeKind and RouterFileEdgeKind list the kinds in the same order
+            AddEdge(Edge<double>{edge.from, edge.to, edge.weight},
+                    EdgeInfo{static_cast<EdgeKind>(edge.kind), edge.owner_index, edge.span_count});
+        }
+        graph_->Freeze();
+        if(!graph::Router<double>::IsValidTable(*graph_, file->GetPrevEdges()))
+        {
+            graph_.reset();
+            edge_infos_.clear();
+            riding_vertex_stops_.clear();
+            vertex_id_ = 0;
+            return false;
+        }
+
+        switch(route_settings_.table_weight_)
+        {
+            case TableWeight::FLOAT:
+                router_ = std::make_unique<graph::Router<double, float>>(*graph_.get(), static_cast<const float*>(file->GetWeights()),
+                                                                          file->GetPrevEdges());
+                break;
+            case TableWeight::DECISECONDS:
+                router_ = std::make_unique<graph::Router<double, DecisecondWeight>>(
+                    *graph_.get(), static_cast<const DecisecondWeight*>(file->GetWeights()), file->GetPrevEdges());
+                break;
+            default:
+                router_ = std::make_unique<graph::Router<double>>(*graph_.get(), static_cast<const double*>(file->GetWeights()),
+                                                                   file->GetPrevEdges());
+                break;
+        }
+        router_file_ = std::move(file);
+        return true;
+    }
+
+    void Router::SaveToFile(uint64_t checksum, const void* weights, size_t weight_size, const uint32_t* prev_edges) const {
+        std::vector<RouterFileEdge> edges;
+        edges.reserve(graph_->GetEdgeCount());
+        for(graph::EdgeId id = 0; id < graph_->GetEdgeCount(); ++id)
+        {
+            const auto& edge = graph_->GetEdge(id);
+            RouterFileEdge file_edge;
+            file_edge.weight = edge.weight;
+            file_edge.from = static_cast<uint32_t>(edge.from);
+            file_edge.to = static_cast<uint32_t>(edge.to);
+            const EdgeInfo& info = edge_infos_[id];
+            file_edge.kind = static_cast<RouterFileEdgeKind>(info.kind_);
+            file_edge.owner_index = info.owner_index_;
+            file_edge.span_count = info.span_count_;
+            edges.push_back(file_edge);
+        }
+
+        RouterFileHeader header;
+        header.weight_size = static_cast<uint32_t>(weight_size);
+        // TableWeight and RouterFileWeightType list the types in the same order
+        header.weight_type = static_cast<RouterFileWeightType>(route_settings_.table_weight_);
+        header.checksum = checksum;
+        header.vertex_count = graph_->GetVertexCount();
+        WriteRouterFile(route_settings_.routing_cache_file_, header, edges, weights, prev_edges);
     }
 
     const graph::DirectedWeightedGraph<double>& Router::GetGraph() const {
@@ -27,103 +470,451 @@ namespace transport_router
 
     std::optional<BuildedRoute> Router::BuildRoute(std::string_view start_stop, std::string_view end_stop) const
     {
-        auto router_info = BuildRouteImpl(start_stop, end_stop);
-        if(!router_info)
+        BuildedRoute route;
+        if(!BuildRoute(start_stop, end_stop, route))
         {
             return std::nullopt;
         }
-        else
+        return route;
+    }
+
+    bool Router::BuildRoute(std::string_view start_stop, std::string_view end_stop, BuildedRoute& route) const
+    {
+        route.items_.clear();
+        route.total_weight_ = 0.0;
+        if(raptor_router_)
+        {
+            return BuildRaptorRoute(start_stop, end_stop, route);
+        }
+        // Edges of the last route built by this thread, kept to reuse their memory
+        thread_local graph::RouterInterface<double>::RouteInfo router_info;
+        if(!BuildRouteImpl(start_stop, end_stop, router_info))
+        {
+            return false;
+        }
+        route.total_weight_ = router_info.weight;
+        const auto& stops = transp_catalogue_->GetAllStops();
+        const auto& buses = transp_catalogue_->GetAllRoutes();
+        // Ride of the linear bus model being assembled from its segment edges
+        BusRouteItem* ride_item = nullptr;
+        for(const graph::EdgeId edge_id : router_info.edges)
         {
-            BuildedRoute route;
-            route.total_weight_ = router_info.value().weight;
-            if(!router_info.value().edges.empty())
+            const EdgeInfo& info = edge_infos_[edge_id];
+            switch(info.kind_)
             {
-                for(size_t i = 0; i < router_info.value().edges.size(); ++i)
+                case EdgeKind::WAIT:
+                    route.items_.push_back(WaitRouteItem{stops[info.owner_index_].stop_name_, route_settings_.bus_wait_time_});
+                    break;
+                case EdgeKind::BOARD:
+                    route.items_.push_back(BusRouteItem{buses[info.owner_index_].bus_name_, 0, 0.0});
+                    ride_item = &std::get<BusRouteItem>(route.items_.back());
+                    break;
+                case EdgeKind::ALIGHT:
+                    ride_item = nullptr;
+                    break;
+                case EdgeKind::BUS:
                 {
-                    if(std::holds_alternative<transport_router::WaitEdgeType>(GetEdgeType(router_info.value().edges.at(i))))
+                    const double time = graph_->GetEdge(edge_id).weight;
+                    if(ride_item)
                     {
-                        WaitRouteItem route_item;
-                        auto wait_edge = std::get<transport_router::WaitEdgeType>(GetEdgeType(router_info.value().edges.at(i)));
-                        route_item.stop_name_ = wait_edge.stop_name_;
-                        route_item.time_ = GetRouteSettings().bus_wait_time_;
-                        route.items_.push_back(std::make_unique<WaitRouteItem>(route_item));
+                        ride_item->span_count_ += static_cast<int>(info.span_count_);
+                        ride_item->time_ += time;
                     }
                     else
                     {
-                        BusRouteItem route_item;
-                        auto bus_edge = std::get<transport_router::BusEdgeType>(GetEdgeType(router_info.value().edges.at(i)));
-                        route_item.bus_ = bus_edge.bus_name_;
-                        route_item.span_count_ = bus_edge.span_count_;
-                        route_item.time_ = bus_edge.time_;
-                        route.items_.push_back(std::make_unique<BusRouteItem>(route_item));
+                        route.items_.push_back(BusRouteItem{buses[info.owner_index_].bus_name_, static_cast<int>(info.span_count_), time});
                     }
+                    break;
                 }
             }
-            return route;
         }
+        return true;
     }
 
-    std::optional<graph::Router<double>::RouteInfo> Router::BuildRouteImpl(std::string_view start_stop, std::string_view end_stop) const {
-        using namespace graph;
+    std::shared_ptr<const BuildedRoute> Router::GetRoute(std::string_view start_stop, std::string_view end_stop) const
+    {
+        const uint64_t key = (static_cast<uint64_t>(GetStopId(start_stop)) << 32) | GetStopId(end_stop);
+        if(auto cached_route = route_cache_.Get(key))
+        {
+            return *cached_route;
+        }
+        std::shared_ptr<const BuildedRoute> route;
+        if(auto built_route = BuildRoute(start_stop, end_stop))
+        {
+            route = std::make_shared<const BuildedRoute>(std::move(*built_route));
+        }
+        // Missing routes are cached too, as nullptr
+        route_cache_.Put(key, route);
+        return route;
+    }
+
+    RouteCacheStats Router::GetRouteCacheStats() const
+    {
+        RouteCacheStats stats;
+        stats.hit_count_ = route_cache_.GetHitCount();
+        stats.miss_count_ = route_cache_.GetMissCount();
+        return stats;
+    }
+
+    std::vector<std::vector<std::optional<double>>> Router::BuildTravelTimeMatrix(const std::vector<std::string_view>& from_stops,
+                                                                                 const std::vector<std::string_view>& to_stops) const
+    {
+        std::vector<std::vector<std::optional<double>>> matrix(from_stops.size());
+        // Names are resolved up front, so that unknown stops throw here and not in the workers
+        if(raptor_router_)
+        {
+            std::vector<uint32_t> sources;
+            std::vector<uint32_t> targets;
+            for(const auto stop_name : from_stops)
+            {
+                sources.push_back(GetStopId(stop_name));
+            }
+            for(const auto stop_name : to_stops)
+            {
+                targets.push_back(GetStopId(stop_name));
+            }
+            parallel::ForEachIndex(sources.size(), [&](size_t i) {
+                matrix[i] = raptor_router_->BuildTimes(sources[i], targets);
+            });
+            return matrix;
+        }
+
+        std::vector<StopId> sources;
+        std::vector<StopId> target_stops;
+        // Stops without buses have no vertices: only the served targets go to the router
+        std::vector<graph::VertexId> targets;
+        std::vector<size_t> target_columns;
+        for(const auto stop_name : from_stops)
+        {
+            sources.push_back(GetStopId(stop_name));
+        }
+        for(size_t column = 0; column < to_stops.size(); ++column)
+        {
+            target_stops.push_back(GetStopId(to_stops[column]));
+            if(IsServed(target_stops.back()))
+            {
+                targets.push_back(GetStopVertex(target_stops.back()));
+                target_columns.push_back(column);
+            }
+        }
+        parallel::ForEachIndex(sources.size(), [&](size_t i) {
+            auto& row = matrix[i];
+            row.assign(to_stops.size(), std::nullopt);
+            if(!IsServed(sources[i]))
+            {
+                // Reaches nothing but itself
+                for(size_t column = 0; column < target_stops.size(); ++column)
+                {
+                    if(target_stops[column] == sources[i])
+                    {
+                        row[column] = 0.0;
+                    }
+                }
+                return;
+            }
+            const auto weights = router_->BuildWeights(GetStopVertex(sources[i]), targets);
+            for(size_t j = 0; j < weights.size(); ++j)
+            {
+                row[target_columns[j]] = weights[j];
+            }
+        });
+        return matrix;
+    }
+
+    void Router::ForEachReachableStop(std::string_view from_stop, double max_time,
+                                      const std::function<void(std::string_view, double)>& func) const
+    {
+        if(max_time < 0)
+        {
+            throw std::invalid_argument("Time budget should be non-negative");
+        }
+        const StopId from = GetStopId(from_stop);
+        const auto& stops = transp_catalogue_->GetAllStops();
+        if(raptor_router_)
+        {
+            raptor_router_->ForEachReachable(from, max_time, [&stops, &func](StopId stop, double time) {
+                func(stops[stop].stop_name_, time);
+            });
+            return;
+        }
+        if(!IsServed(from))
+        {
+            func(stops[from].stop_name_, 0.0);
+            return;
+        }
+        // Wait vertices stand for the stops, the time to reach one is the time to arrive at the stop
+        const graph::VertexId stop_vertex_count = served_stops_.size() * 2;
+        auto on_vertex = [this, &stops, &func, stop_vertex_count](graph::VertexId vertex, double time) {
+            if(vertex < stop_vertex_count && vertex % 2 == 0)
+            {
+                func(stops[served_stops_[vertex / 2]].stop_name_, time);
+            }
+        };
+        if(!router_->ForEachReachable(GetStopVertex(from), max_time, on_vertex))
+        {
+            graph::ForEachVertexWithinWeight(*graph_, GetStopVertex(from), max_time, on_vertex);
+        }
+    }
+
+    bool Router::BuildRaptorRoute(std::string_view start_stop, std::string_view end_stop, BuildedRoute& route) const
+    {
+        auto journey = raptor_router_->BuildRoute(GetStopId(start_stop), GetStopId(end_stop));
+        if(!journey)
+        {
+            return false;
+        }
+        route.total_weight_ = journey->total_time;
+        for(const auto& leg : journey->legs)
+        {
+            const Stop& board_stop = transp_catalogue_->GetAllStops().at(raptor_router_->GetStopAt(leg.bus_index, leg.board_position));
+            route.items_.push_back(WaitRouteItem{board_stop.stop_name_, route_settings_.bus_wait_time_});
+            route.items_.push_back(BusRouteItem{transp_catalogue_->GetAllRoutes().at(leg.bus_index).bus_name_,
+                                                static_cast<int>(leg.alight_position - leg.board_position), leg.time});
+        }
+        return true;
+    }
+
+    bool Router::BuildRouteImpl(std::string_view start_stop, std::string_view end_stop, graph::RouterInterface<double>::RouteInfo& info) const {
         if(start_stop == end_stop)
         {
-            graph::Router<double>::RouteInfo info;
             info.weight = 0;
-            return info;
+            info.edges.clear();
+            return true;
+        }
+        const StopId from = GetStopId(start_stop);
+        const StopId to = GetStopId(end_stop);
+        // A stop without buses is not in the graph and has no route to another stop
+        if(!IsServed(from) || !IsServed(to))
+        {
+            return false;
         }
-        return (*router_.get()).BuildRoute(stopname_to_vertex_id_.at(start_stop).first, stopname_to_vertex_id_.at(end_stop).first);
+        return router_->BuildRouteInto(GetStopVertex(from), GetStopVertex(to), info);
     }
 
-    const EdgeType& Router::GetEdgeType(graph::EdgeId id) const
+    const EdgeInfo& Router::GetEdgeInfo(graph::EdgeId id) const
     {
-        using namespace graph;
-        return edge_id_type_.at(id);
+        return edge_infos_.at(id);
     }
 
     const std::string_view Router::GetStopNameByVertexId(graph::VertexId id) const
     {
-        if(id % 2 == 0)
+        const auto& stops = transp_catalogue_->GetAllStops();
+        const graph::VertexId stop_vertex_count = served_stops_.size() * 2;
+        if(id >= stop_vertex_count)
+        {
+            return stops[riding_vertex_stops_.at(id - stop_vertex_count)].stop_name_;
+        }
+        return stops[served_stops_[id / 2]].stop_name_;
+    }
+
+    StopId Router::GetStopId(std::string_view stop_name) const
+    {
+        const Stop* stop = transp_catalogue_->SearchStop(stop_name);
+        if(!stop)
+        {
+            throw std::out_of_range("Unknown stop: " + std::string(stop_name));
+        }
+        return stop->id_;
+    }
+
+    bool Router::IsServed(StopId stop) const
+    {
+        return stop_vertices_[stop] != NO_VERTEX;
+    }
+
+    graph::VertexId Router::GetStopVertex(StopId stop) const
+    {
+        return stop_vertices_[stop];
+    }
+
+    graph::EdgeId Router::AddEdge(const graph::Edge<double>& edge, EdgeInfo info)
+    {
+        const graph::EdgeId id = graph_->AddEdge(edge);
+        edge_infos_.push_back(info);
+        return id;
+    }
+
+    graph::EdgeId Router::AllocateEdges(size_t count)
+    {
+        edge_infos_.resize(edge_infos_.size() + count);
+        return graph_->AllocateEdges(count);
+    }
+
+    void Router::SetEdge(graph::EdgeId id, const graph::Edge<double>& edge, EdgeInfo info)
+    {
+        graph_->SetEdge(id, edge);
+        edge_infos_[id] = info;
+    }
+
+    graph::AStarRouter<double>::Potential Router::MakeGeoPotential() const
+    {
+        // Minutes per meter of the straight line, the lowest over all the segments buses ride.
+        // Road distances may be shorter than the straight-line ones, so 1 / bus_velocity_ is not a bound
+        double min_time_per_meter = std::numeric_limits<double>::infinity();
+        for(const auto& bus : transp_catalogue_->GetAllRoutes())
+        {
+            for(size_t i = 1; i < bus.route_.size(); ++i)
+            {
+                const double straight_distance = geo::ComputeDistance(bus.route_.at(i-1)->stop_coordinates_,
+                                                                      bus.route_.at(i)->stop_coordinates_);
+                if(straight_distance > 0)
+                {
+                    const double distance = bus.cumulative_distances_[i] - bus.cumulative_distances_[i-1];
+                    const double time = (distance / (1000 * route_settings_.bus_velocity_)) * 60;
+                    min_time_per_meter = std::min(min_time_per_meter, time / straight_distance);
+                }
+            }
+        }
+        if(!std::isfinite(min_time_per_meter))
+        {
+            min_time_per_meter = 0.0;
+        }
+        // Margin for the rounding of the distances, keeps the bound below the real weights
+        min_time_per_meter *= 1.0 - 1e-9;
+
+        const auto& stops = transp_catalogue_->GetAllStops();
+        std::vector<geo::Coordinates> coordinates(vertex_id_);
+        for(size_t i = 0; i < served_stops_.size(); ++i)
+        {
+            coordinates[2 * i] = stops[served_stops_[i]].stop_coordinates_;
+            coordinates[2 * i + 1] = stops[served_stops_[i]].stop_coordinates_;
+        }
+        const size_t stop_vertex_count = served_stops_.size() * 2;
+        for(size_t i = 0; i < riding_vertex_stops_.size(); ++i)
         {
-            return vertex_id_stop_.at(id).stop_name_;
+            coordinates[stop_vertex_count + i] = stops[riding_vertex_stops_[i]].stop_coordinates_;
         }
-        else
+        return [coordinates = std::move(coordinates), min_time_per_meter](graph::VertexId vertex, graph::VertexId target)
         {
-            return vertex_id_stop_.at(id-1).stop_name_;
+            if(coordinates[vertex] == coordinates[target])
+            {
+                return 0.0;
+            }
+            const double straight_distance = geo::ComputeDistance(coordinates[vertex], coordinates[target]);
+            // acos of a value rounded above 1 gives NaN for very close stops
+            return straight_distance > 0 ? straight_distance * min_time_per_meter : 0.0;
+        };
+    }
+
+    void Router::SetServedStops() {
+        const auto& stops = transp_catalogue_->GetAllStops();
+        stop_vertices_.assign(stops.size(), NO_VERTEX);
+        served_stops_.clear();
+        for(const auto& stop : stops)
+        {
+            if(!stop.routes_.empty())
+            {
+                stop_vertices_[stop.id_] = static_cast<graph::VertexId>(served_stops_.size()) * 2;
+                served_stops_.push_back(stop.id_);
+            }
         }
     }
 
     void Router::SetAllStops() {
         using namespace graph;
-        for(const auto& stop : transp_catalogue_->GetAllStops())
+        edge_infos_.reserve(served_stops_.size());
+        for(const StopId stop : served_stops_)
         {
             Edge edge{vertex_id_, vertex_id_ + 1, static_cast<double>(route_settings_.bus_wait_time_)};
-            edge_id_type_.insert({(*graph_.get()).AddEdge(edge), WaitEdgeType(stop.stop_name_)});
-            stopname_to_vertex_id_.insert({stop.stop_name_, std::make_pair(vertex_id_, vertex_id_ + 1)});
-            vertex_id_stop_.insert({vertex_id_, stop});
+            AddEdge(edge, EdgeInfo{EdgeKind::WAIT, stop, 0});
             vertex_id_ += 2;
-            
         }
     }
 
     void Router::SetAllBuses() {
+        // A prefix sum of the edge counts gives every bus a fixed range of edge ids, so the
+        // buses are written in parallel and the numbering is the same as in a serial build
+        const auto& buses = transp_catalogue_->GetAllRoutes();
+        std::vector<graph::EdgeId> first_edges(buses.size() + 1, 0);
+        std::vector<graph::VertexId> first_riding_vertices(buses.size(), 0);
+        for(size_t i = 0; i < buses.size(); ++i)
+        {
+            first_edges[i + 1] = first_edges[i] + CountBusEdges(buses[i]);
+            if(route_settings_.linear_bus_model_)
+            {
+                first_riding_vertices[i] = AddRidingVertices(buses[i]);
+            }
+        }
+        const graph::EdgeId first_edge = AllocateEdges(first_edges.back());
+        parallel::ForEachIndex(buses.size(), [&](size_t i) {
+            SetBusEdges(buses[i], first_edge + first_edges[i], first_riding_vertices[i]);
+        });
+    }
+
+    size_t Router::CountVertices() const {
+        size_t vertex_count = served_stops_.size() * 2;
+        if(route_settings_.linear_bus_model_)
+        {
+            for(const auto& bus : transp_catalogue_->GetAllRoutes())
+            {
+                vertex_count += bus.route_.size();
+            }
+        }
+        return vertex_count;
+    }
+
+    graph::VertexId Router::AddRidingVertices(const Bus& bus) {
+        const graph::VertexId first_vertex = vertex_id_;
+        for(const StopId stop : bus.stop_ids_)
+        {
+            riding_vertex_stops_.push_back(stop);
+            ++vertex_id_;
+        }
+        return first_vertex;
+    }
+
+    size_t Router::CountBusEdges(const Bus& bus) const {
+        const size_t stop_count = bus.stop_ids_.size();
+        if(stop_count < 2)
+        {
+            return 0;
+        }
+        // Board, ride and alight edge per segment, or an edge for every pair of stops
+        return route_settings_.linear_bus_model_ ? 3 * (stop_count - 1) : stop_count * (stop_count - 1) / 2;
+    }
+
+    void Router::SetLinearBusEdges(const Bus& bus, graph::EdgeId edge_id, graph::VertexId first_vertex) {
         using namespace graph;
-        for(const auto& bus : transp_catalogue_->GetAllRoutes())
+        for(size_t i = 0; i < bus.stop_ids_.size(); ++i)
         {
-            for(size_t i = 0; i < bus.route_.size() - 1; ++i)
+            const VertexId stop_vertex = GetStopVertex(bus.stop_ids_[i]);
+            // No boarding at the last stop and no alighting at the first one
+            if(i + 1 < bus.stop_ids_.size())
             {
-                const auto& stop_from = *(bus.route_.at(i));
-                double distance = 0.0;
-                for(size_t j = i + 1; j < bus.route_.size(); ++j)
-                {
-                    const auto& stop_to = *(bus.route_.at(j));
-                    distance += transp_catalogue_->GetDistance(bus.route_.at(j-1)->stop_name_, stop_to.stop_name_);
-                    double time = (distance / (1000 * route_settings_.bus_velocity_)) * 60; // 1000 - meters to km, 60 hours to minutes
-                    Edge edge{stopname_to_vertex_id_.at(stop_from.stop_name_).second, 
-                                stopname_to_vertex_id_.at(stop_to.stop_name_).first, 
-                                time};
-                    edge_id_type_.insert({(*graph_.get()).AddEdge(edge), BusEdgeType(bus.bus_name_, j - i, time)});
-                }
+                SetEdge(edge_id++, Edge<double>{stop_vertex + 1, first_vertex + i, 0.0}, EdgeInfo{EdgeKind::BOARD, bus.id_, 0});
+            }
+            if(i > 0)
+            {
+                const double distance = bus.cumulative_distances_[i] - bus.cumulative_distances_[i-1];
+                const double time = (distance / (1000 * route_settings_.bus_velocity_)) * 60; // 1000 - meters to km, 60 hours to minutes
+                SetEdge(edge_id++, Edge<double>{first_vertex + i - 1, first_vertex + i, time}, EdgeInfo{EdgeKind::BUS, bus.id_, 1});
+                SetEdge(edge_id++, Edge<double>{first_vertex + i, stop_vertex, 0.0}, EdgeInfo{EdgeKind::ALIGHT, 0, 0});
+            }
+        }
+    }
+
+    void Router::SetBusEdges(const Bus& bus, graph::EdgeId edge_id, graph::VertexId first_riding_vertex) {
+        using namespace graph;
+        if(route_settings_.linear_bus_model_)
+        {
+            SetLinearBusEdges(bus, edge_id, first_riding_vertex);
+            return;
+        }
+        for(size_t i = 0; i + 1 < bus.stop_ids_.size(); ++i)
+        {
+            const VertexId from_vertex = GetStopVertex(bus.stop_ids_[i]) + 1;
+            for(size_t j = i + 1; j < bus.stop_ids_.size(); ++j)
+            {
+                const double distance = bus.cumulative_distances_[j] - bus.cumulative_distances_[i];
+                double time = (distance / (1000 * route_settings_.bus_velocity_)) * 60; // 1000 - meters to km, 60 hours to minutes
+                Edge edge{from_vertex, GetStopVertex(bus.stop_ids_[j]), time};
+                SetEdge(edge_id++, edge, EdgeInfo{EdgeKind::BUS, bus.id_, static_cast<uint32_t>(j - i)});
             }
         }
     }
+
+    void Router::SetBus(const Bus& bus) {
+        const graph::VertexId first_riding_vertex = route_settings_.linear_bus_model_ ? AddRidingVertices(bus) : 0;
+        SetBusEdges(bus, AllocateEdges(CountBusEdges(bus)), first_riding_vertex);
+    }
 }
\ No newline at end of file
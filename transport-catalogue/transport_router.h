@@ -1,63 +1,172 @@
 #pragma once
 
+#include <cstdint>
+#include <functional>
+#include <limits>
 #include <string>
 #include <optional>
 #include <unordered_map>
 #include <memory>
-#include <variant>
+#include <ostream>
 
 #include "transport_catalogue.h"
 #include "domain.h"
 #include "graph.h"
 #include "router.h"
+#include "component_router.h"
+#include "dijkstra_router.h"
+#include "contraction_hierarchy_router.h"
+#include "astar_router.h"
+#include "overlay_router.h"
+#include "hub_label_router.h"
+#include "router_file.h"
+#include "raptor_router.h"
+#include "lru_cache.h"
 
 namespace transport_router
 {
-    struct WaitEdgeType {
-        WaitEdgeType(std::string_view stop_name) : stop_name_(stop_name) {}
-        std::string_view stop_name_;
+    enum class EdgeKind : uint8_t {
+        WAIT,
+        BUS,
+        // Edges between the stop and the riding vertices of the linear bus model
+        BOARD,
+        ALIGHT
     };
 
-    struct BusEdgeType {
-        BusEdgeType(std::string_view bus_name) : bus_name_(bus_name) {}
-        BusEdgeType(std::string_view bus_name, size_t span_count, double time) : 
-                                bus_name_(bus_name), span_count_(span_count), time_(time) {}
-        std::string_view bus_name_;
-        size_t span_count_ = 0;
-        double time_ = 0.0;
+    // Metadata of a graph edge; the ride time of a bus edge is its weight
+    struct EdgeInfo {
+        EdgeKind kind_ = EdgeKind::WAIT;
+        // StopId for wait edges, BusId for bus and board edges
+        uint32_t owner_index_ = 0;
+        uint32_t span_count_ = 0;
     };
 
+    // Weights of a decisecond all-pairs table: the graph weights are minutes
+    using DecisecondWeight = graph::FixedPointWeight<uint32_t, 600>;
+
     struct BuildedRoute
     {
-        std::vector<std::unique_ptr<RouteItem>> items_;
+        std::vector<RouteItem> items_;
         double total_weight_ = 0.0;
     };
 
-    using EdgeType = std::variant<WaitEdgeType, BusEdgeType>;
+    struct RouteCacheStats {
+        size_t hit_count_ = 0;
+        size_t miss_count_ = 0;
+    };
 
     class Router {
         public:
         void SetRouteSettings(int wait_time, double bus_velocity);
+        void SetRoutingEngine(RoutingEngine engine);
+        void SetLinearBusModel(bool is_linear);
+        // Float table weights if is_compact, double otherwise
+        void SetCompactRoutingTable(bool is_compact);
+        void SetTableWeight(TableWeight table_weight);
+        void SetTableAlgorithm(TableAlgorithm table_algorithm);
+        void SetRoutingCacheFile(std::string path);
+        void SetRouteCacheSize(size_t size);
+        // 0 lifts the bound on the trees kept by the Dijkstra engine
+        void SetDijkstraCachedTrees(size_t count);
+        void SetMemoryPlacement(const memory::PlacementSettings& settings);
+        void SetMemoryReport(bool is_enabled);
 		const RouteSettings& GetRouteSettings() const;
         void FormGraph(const transport_catalogue::TransportCatalogue &transp_catalogue);
+        // Adds a bus that was added to the catalogue after FormGraph. The all-pairs table
+        // is repaired in place, other engines are rebuilt over the extended graph.
+        // Stops that get their first bus change the vertex set, so they lead to a full FormGraph.
+        void AddBus(std::string_view bus_name);
+        // Not available for RoutingEngine::RAPTOR, which builds no graph
         const graph::DirectedWeightedGraph<double>& GetGraph() const;
         std::optional<BuildedRoute> BuildRoute(std::string_view start_stop, std::string_view end_stop) const;
-        const EdgeType& GetEdgeType(graph::EdgeId id) const;
+        // Builds the route into the caller's buffer, reusing the memory of its items; returns false if there is no route
+        bool BuildRoute(std::string_view start_stop, std::string_view end_stop, BuildedRoute& route) const;
+        // BuildRoute through the route cache; nullptr if there is no route
+        std::shared_ptr<const BuildedRoute> GetRoute(std::string_view start_stop, std::string_view end_stop) const;
+        RouteCacheStats GetRouteCacheStats() const;
+        // Travel times from each of from_stops (rows) to each of to_stops (columns), nullopt
+        // where there is no route. One search per source, sources run in parallel.
+        std::vector<std::vector<std::optional<double>>> BuildTravelTimeMatrix(const std::vector<std::string_view>& from_stops,
+                                                                             const std::vector<std::string_view>& to_stops) const;
+        // Calls func(stop_name, time) for every stop reachable from from_stop within max_time
+        // minutes, the start stop included, in no particular order; routes are not built.
+        // Reads the all-pairs table when there is one, otherwise searches up to the budget.
+        void ForEachReachableStop(std::string_view from_stop, double max_time,
+                                  const std::function<void(std::string_view, double)>& func) const;
+        // Placement settings, then the size, huge page share and NUMA nodes of the graph
+        // arrays and of the all-pairs table with its replicas
+        void ReportMemoryPlacement(std::ostream& out) const;
+        const EdgeInfo& GetEdgeInfo(graph::EdgeId id) const;
         const std::string_view GetStopNameByVertexId(graph::VertexId id) const;
         private:
+        // Numbers the stops with buses; stops without any get no vertices
+        void SetServedStops();
         void SetAllStops();
         void SetAllBuses();
-        std::optional<graph::Router<double>::RouteInfo> BuildRouteImpl(std::string_view start_stop, std::string_view end_stop) const;
+        void SetBus(const Bus& bus);
+        size_t CountBusEdges(const Bus& bus) const;
+        // Write the edges of the bus into the allocated ids from edge_id on; safe to run
+        // for different buses concurrently
+        void SetBusEdges(const Bus& bus, graph::EdgeId edge_id, graph::VertexId first_riding_vertex);
+        void SetLinearBusEdges(const Bus& bus, graph::EdgeId edge_id, graph::VertexId first_vertex);
+        // Registers the riding vertices of the bus, one per stop of its route; returns the first of them
+        graph::VertexId AddRidingVertices(const Bus& bus);
+        // Names are resolved once per request, everything below works on the ids
+        StopId GetStopId(std::string_view stop_name) const;
+        bool IsServed(StopId stop) const;
+        // The k-th served stop has the wait vertex 2k, the ride vertex 2k + 1 follows it
+        graph::VertexId GetStopVertex(StopId stop) const;
+        graph::EdgeId AddEdge(const graph::Edge<double>& edge, EdgeInfo info);
+        // Bulk counterparts of AddEdge, see DirectedWeightedGraph::AllocateEdges
+        graph::EdgeId AllocateEdges(size_t count);
+        void SetEdge(graph::EdgeId id, const graph::Edge<double>& edge, EdgeInfo info);
+        size_t CountVertices() const;
+        // Creates the router of the selected engine over the built graph
+        void FormRouter(bool use_cache_file, uint64_t checksum);
+        template <typename StoredWeight>
+        bool UpdateAllPairsRouter();
+        // Lower bound of the travel time between stops by the straight-line distance
+        graph::AStarRouter<double>::Potential MakeGeoPotential() const;
+        template <typename StoredWeight>
+        void FormAllPairsRouter(bool save_to_file, uint64_t checksum);
+        // Loads the labels from the routing cache file if it has them for this graph,
+        // otherwise builds them and saves them there
+        void FormHubLabelRouter();
+        template <typename StoredWeight>
+        void ReportTablePlacement(std::ostream& out) const;
+        // Checksum of everything the graph is built from: stops, buses, distances and settings
+        uint64_t ComputeChecksum() const;
+        // False if the file is missing, stale or damaged; the router is then built anew
+        bool LoadFromFile(uint64_t checksum);
+        void SaveToFile(uint64_t checksum, const void* weights, size_t weight_size, const uint32_t* prev_edges) const;
+        bool BuildRouteImpl(std::string_view start_stop, std::string_view end_stop, graph::RouterInterface<double>::RouteInfo& info) const;
+        bool BuildRaptorRoute(std::string_view start_stop, std::string_view end_stop, BuildedRoute& route) const;
         const transport_catalogue::TransportCatalogue *transp_catalogue_;
-        std::unordered_map<graph::VertexId, const Stop&> vertex_id_stop_;
+        static constexpr graph::VertexId NO_VERTEX = std::numeric_limits<graph::VertexId>::max();
         graph::VertexId vertex_id_ = 0;
-
-        std::unordered_map<graph::EdgeId, EdgeType> edge_id_type_;
-        std::unordered_map<std::string_view, std::pair<graph::VertexId, graph::VertexId>> stopname_to_vertex_id_;
+        // Wait vertex of every stop, NO_VERTEX for the stops without buses
+        std::vector<graph::VertexId> stop_vertices_;
+        // Stop of every pair of stop vertices: served_stops_[vertex / 2]
+        std::vector<StopId> served_stops_;
+        // Stops of the riding vertices, which follow the vertices of the stops
+        std::vector<StopId> riding_vertex_stops_;
+        // Indexed by EdgeId
+        std::vector<EdgeInfo> edge_infos_;
 
         std::unique_ptr<graph::DirectedWeightedGraph<double>> graph_;
-        std::unique_ptr<graph::Router<double>> router_;
+        // Declared before router_ so that a router served from the mapping is destroyed first
+        std::unique_ptr<MappedRouterFile> router_file_;
+        std::unique_ptr<graph::RouterInterface<double>> router_;
+        // Set instead of graph_ and router_ for RoutingEngine::RAPTOR
+        std::unique_ptr<RaptorRouter> raptor_router_;
+        // Kept across FormGraph: while the topology stays the same, new settings only
+        // re-customize the overlay
+        std::shared_ptr<const graph::OverlayPartition> overlay_partition_;
 
         RouteSettings route_settings_;
+
+        // Keyed by (from << 32 | to) stop ids. Cleared by FormGraph and AddBus, so entries
+        // never outlive the graph and settings they were built with
+        mutable LruCache<uint64_t, std::shared_ptr<const BuildedRoute>> route_cache_;
     };
 }
\ No newline at end of file